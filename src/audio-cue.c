@@ -0,0 +1,410 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <obs-module.h>
+#include <plugin-support.h>
+#include "audio-cue.h"
+
+#define AUDIO_CUE_PI 3.14159265358979f
+#define AUDIO_CUE_MIN_HZ 200.0
+#define AUDIO_CUE_MAX_HZ 8000.0
+#define AUDIO_CUE_DB_STEPS 2.0f
+#define AUDIO_CUE_DYNAMIC_RANGE 30.0f
+// frames quieter than this never match, silence matches every flat cue
+#define AUDIO_CUE_MIN_LEVEL -50.0f
+// mean absolute band difference in half dB steps
+#define AUDIO_CUE_MAX_DISTANCE 8
+#define AUDIO_CUE_COOLDOWN_FRAMES 200
+
+struct audio_cue {
+	char *name;
+	enum audio_cue_type type;
+	uint32_t num_frames;
+	int8_t *bands;
+};
+
+struct audio_cue_table {
+	struct audio_cue *cues;
+	uint32_t num_cues;
+};
+
+struct audio_cue_detector {
+	const struct audio_cue_table *table;
+
+	float window[AUDIO_CUE_FFT_SIZE];
+	float cos_table[AUDIO_CUE_FFT_SIZE / 2];
+	float sin_table[AUDIO_CUE_FFT_SIZE / 2];
+	uint16_t bitrev[AUDIO_CUE_FFT_SIZE];
+	uint32_t band_start[AUDIO_CUE_BANDS + 1];
+	float power_scale;
+
+	float input[AUDIO_CUE_FFT_SIZE];
+	uint32_t input_len;
+	float re[AUDIO_CUE_FFT_SIZE];
+	float im[AUDIO_CUE_FFT_SIZE];
+
+	int8_t history[AUDIO_CUE_MAX_FRAMES][AUDIO_CUE_BANDS];
+	float level;
+	uint32_t history_pos;
+	uint64_t frames;
+	uint64_t cooldown[AUDIO_CUE_MAX_CUES];
+};
+
+const char *audio_cue_type_name(enum audio_cue_type type)
+{
+	switch (type) {
+	case AUDIO_CUE_LOADIN:
+		return "loadin";
+	case AUDIO_CUE_GO:
+		return "go";
+	case AUDIO_CUE_GAME:
+		return "game";
+	case AUDIO_CUE_NONE:
+		break;
+	}
+	return "none";
+}
+
+enum audio_cue_type audio_cue_type_from_name(const char *name)
+{
+	for (int type = AUDIO_CUE_LOADIN; type <= AUDIO_CUE_GAME; type++) {
+		if (strcmp(audio_cue_type_name(type), name) == 0)
+			return type;
+	}
+
+	return AUDIO_CUE_NONE;
+}
+
+static bool read_u32(FILE *fp, uint32_t *val)
+{
+	uint8_t buf[4];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf))
+		return false;
+	*val = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+	return true;
+}
+
+static bool read_u16(FILE *fp, uint32_t *val)
+{
+	uint8_t buf[2];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf))
+		return false;
+	*val = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8);
+	return true;
+}
+
+void audio_cue_table_destroy(struct audio_cue_table *table)
+{
+	if (!table) {
+		return;
+	}
+
+	if (table->cues) {
+		for (uint32_t i = 0; i < table->num_cues; i++) {
+			bfree(table->cues[i].name);
+			bfree(table->cues[i].bands);
+		}
+	}
+
+	bfree(table->cues);
+	bfree(table);
+}
+
+struct audio_cue_table *audio_cue_table_load(const char *path)
+{
+	struct audio_cue_table *table = NULL;
+	char magic[4];
+	uint32_t version;
+
+	if (!path) {
+		obs_log(LOG_INFO, "No audio cue table found, audio pre-trigger disabled");
+		return NULL;
+	}
+
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		goto error;
+	}
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+	    memcmp(magic, AUDIO_CUE_TABLE_MAGIC, sizeof(magic)) != 0 ||
+	    !read_u32(fp, &version) || version != AUDIO_CUE_TABLE_VERSION) {
+		goto error;
+	}
+
+	table = bzalloc(sizeof(struct audio_cue_table));
+	if (!read_u32(fp, &table->num_cues) || table->num_cues > AUDIO_CUE_MAX_CUES) {
+		goto error;
+	}
+
+	table->cues = bzalloc(sizeof(struct audio_cue) * table->num_cues);
+
+	for (uint32_t i = 0; i < table->num_cues; i++) {
+		struct audio_cue *cue = &table->cues[i];
+		uint8_t len, type;
+
+		if (fread(&len, 1, 1, fp) != 1) {
+			goto error;
+		}
+
+		cue->name = bzalloc(len + 1);
+		if (fread(cue->name, 1, len, fp) != len || fread(&type, 1, 1, fp) != 1 ||
+		    !read_u16(fp, &cue->num_frames)) {
+			goto error;
+		}
+
+		if (type < AUDIO_CUE_LOADIN || type > AUDIO_CUE_GAME || !cue->num_frames ||
+		    cue->num_frames > AUDIO_CUE_MAX_FRAMES) {
+			goto error;
+		}
+
+		cue->type = type;
+		cue->bands = bmalloc(cue->num_frames * AUDIO_CUE_BANDS);
+		if (fread(cue->bands, 1, cue->num_frames * AUDIO_CUE_BANDS, fp) !=
+		    cue->num_frames * AUDIO_CUE_BANDS) {
+			goto error;
+		}
+	}
+
+	fclose(fp);
+	obs_log(LOG_INFO, "Loaded %u audio cues", table->num_cues);
+	return table;
+
+error:
+	obs_log(LOG_WARNING, "Failed to load audio cue table '%s'", path);
+	if (fp)
+		fclose(fp);
+	audio_cue_table_destroy(table);
+	return NULL;
+}
+
+uint32_t audio_cue_table_size(const struct audio_cue_table *table)
+{
+	return table ? table->num_cues : 0;
+}
+
+struct audio_cue_detector *audio_cue_detector_create(const struct audio_cue_table *table,
+						     uint32_t sample_rate)
+{
+	struct audio_cue_detector *detector = bzalloc(sizeof(struct audio_cue_detector));
+	uint32_t bits = 0;
+	float window_sum = 0.0f;
+
+	detector->table = table;
+
+	while ((1u << bits) < AUDIO_CUE_FFT_SIZE)
+		bits++;
+
+	for (uint32_t i = 0; i < AUDIO_CUE_FFT_SIZE; i++) {
+		uint32_t rev = 0;
+		for (uint32_t b = 0; b < bits; b++) {
+			rev |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		detector->bitrev[i] = (uint16_t)rev;
+
+		detector->window[i] = 0.5f - 0.5f * cosf(2.0f * AUDIO_CUE_PI * (float)i /
+							 (float)AUDIO_CUE_FFT_SIZE);
+		window_sum += detector->window[i];
+	}
+
+	for (uint32_t i = 0; i < AUDIO_CUE_FFT_SIZE / 2; i++) {
+		detector->cos_table[i] = cosf(2.0f * AUDIO_CUE_PI * (float)i / AUDIO_CUE_FFT_SIZE);
+		detector->sin_table[i] = sinf(2.0f * AUDIO_CUE_PI * (float)i / AUDIO_CUE_FFT_SIZE);
+	}
+
+	// a full scale sine reads as 0 dB
+	detector->power_scale = (2.0f / window_sum) * (2.0f / window_sum);
+
+	// log spaced band edges, at least one bin each
+	for (uint32_t b = 0; b <= AUDIO_CUE_BANDS; b++) {
+		double hz = AUDIO_CUE_MIN_HZ *
+			    pow(AUDIO_CUE_MAX_HZ / AUDIO_CUE_MIN_HZ, (double)b / AUDIO_CUE_BANDS);
+		uint32_t bin = (uint32_t)(hz * AUDIO_CUE_FFT_SIZE / sample_rate + 0.5);
+
+		if (b > 0 && bin <= detector->band_start[b - 1])
+			bin = detector->band_start[b - 1] + 1;
+		if (bin > AUDIO_CUE_FFT_SIZE / 2)
+			bin = AUDIO_CUE_FFT_SIZE / 2;
+		detector->band_start[b] = bin;
+	}
+
+	return detector;
+}
+
+void audio_cue_detector_destroy(struct audio_cue_detector *detector)
+{
+	bfree(detector);
+}
+
+static void fft(struct audio_cue_detector *detector)
+{
+	float *re = detector->re;
+	float *im = detector->im;
+
+	for (uint32_t size = 2; size <= AUDIO_CUE_FFT_SIZE; size <<= 1) {
+		uint32_t half = size / 2;
+		uint32_t step = AUDIO_CUE_FFT_SIZE / size;
+
+		for (uint32_t i = 0; i < AUDIO_CUE_FFT_SIZE; i += size) {
+			for (uint32_t j = 0; j < half; j++) {
+				float wr = detector->cos_table[j * step];
+				float wi = -detector->sin_table[j * step];
+				uint32_t a = i + j;
+				uint32_t b = a + half;
+
+				float tr = wr * re[b] - wi * im[b];
+				float ti = wr * im[b] + wi * re[b];
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+static void analyze_frame(struct audio_cue_detector *detector)
+{
+	float db[AUDIO_CUE_BANDS];
+	float mean = 0.0f;
+	float peak = -1000.0f;
+
+	for (uint32_t i = 0; i < AUDIO_CUE_FFT_SIZE; i++) {
+		detector->re[detector->bitrev[i]] = detector->input[i] * detector->window[i];
+		detector->im[i] = 0.0f;
+	}
+
+	fft(detector);
+
+	for (uint32_t b = 0; b < AUDIO_CUE_BANDS; b++) {
+		uint32_t start = detector->band_start[b];
+		uint32_t end = detector->band_start[b + 1];
+		float energy = 0.0f;
+
+		for (uint32_t k = start; k < end; k++) {
+			energy += detector->re[k] * detector->re[k] + detector->im[k] * detector->im[k];
+		}
+
+		energy *= detector->power_scale / (float)(end > start ? end - start : 1);
+		db[b] = 10.0f * log10f(energy + 1e-12f);
+		peak = db[b] > peak ? db[b] : peak;
+		mean += db[b];
+	}
+
+	detector->level = mean / AUDIO_CUE_BANDS;
+
+	// quiet bands are mostly background noise, don't let their exact level count
+	mean = 0.0f;
+	for (uint32_t b = 0; b < AUDIO_CUE_BANDS; b++) {
+		if (db[b] < peak - AUDIO_CUE_DYNAMIC_RANGE)
+			db[b] = peak - AUDIO_CUE_DYNAMIC_RANGE;
+		mean += db[b];
+	}
+	mean /= AUDIO_CUE_BANDS;
+
+	int8_t *bands = detector->history[detector->history_pos];
+	for (uint32_t b = 0; b < AUDIO_CUE_BANDS; b++) {
+		float value = (db[b] - mean) * AUDIO_CUE_DB_STEPS;
+		value = value > 127.0f ? 127.0f : value < -127.0f ? -127.0f : value;
+		bands[b] = (int8_t)lrintf(value);
+	}
+
+	detector->history_pos = (detector->history_pos + 1) % AUDIO_CUE_MAX_FRAMES;
+	detector->frames++;
+}
+
+static enum audio_cue_type match_cues(struct audio_cue_detector *detector)
+{
+	const struct audio_cue_table *table = detector->table;
+
+	if (!table || detector->level < AUDIO_CUE_MIN_LEVEL) {
+		return AUDIO_CUE_NONE;
+	}
+
+	for (uint32_t c = 0; c < table->num_cues; c++) {
+		const struct audio_cue *cue = &table->cues[c];
+		uint32_t limit = AUDIO_CUE_MAX_DISTANCE * cue->num_frames * AUDIO_CUE_BANDS;
+		uint32_t total = 0;
+
+		if (detector->frames < cue->num_frames || detector->frames < detector->cooldown[c]) {
+			continue;
+		}
+
+		// compare the cue against the most recent frames, oldest first
+		uint32_t pos = (detector->history_pos + AUDIO_CUE_MAX_FRAMES - cue->num_frames) %
+			       AUDIO_CUE_MAX_FRAMES;
+
+		for (uint32_t f = 0; f < cue->num_frames && total <= limit; f++) {
+			const int8_t *bands = detector->history[pos];
+			const int8_t *ref = &cue->bands[f * AUDIO_CUE_BANDS];
+
+			for (uint32_t b = 0; b < AUDIO_CUE_BANDS; b++) {
+				int diff = bands[b] - ref[b];
+				total += (uint32_t)(diff < 0 ? -diff : diff);
+			}
+
+			pos = (pos + 1) % AUDIO_CUE_MAX_FRAMES;
+		}
+
+		if (total <= limit) {
+			detector->cooldown[c] = detector->frames + AUDIO_CUE_COOLDOWN_FRAMES;
+			return cue->type;
+		}
+	}
+
+	return AUDIO_CUE_NONE;
+}
+
+enum audio_cue_type audio_cue_detector_process(struct audio_cue_detector *detector,
+					       const float *const *planes, uint32_t channels,
+					       uint32_t frames)
+{
+	enum audio_cue_type result = AUDIO_CUE_NONE;
+	uint32_t used_channels = 0;
+
+	for (uint32_t c = 0; c < channels; c++) {
+		used_channels += planes[c] ? 1 : 0;
+	}
+
+	if (!used_channels) {
+		return AUDIO_CUE_NONE;
+	}
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float sample = 0.0f;
+
+		for (uint32_t c = 0; c < channels; c++) {
+			if (planes[c])
+				sample += planes[c][i];
+		}
+
+		detector->input[detector->input_len++] = sample / (float)used_channels;
+
+		if (detector->input_len == AUDIO_CUE_FFT_SIZE) {
+			analyze_frame(detector);
+
+			enum audio_cue_type cue = match_cues(detector);
+			if (cue != AUDIO_CUE_NONE) {
+				result = cue;
+			}
+
+			memmove(detector->input, detector->input + AUDIO_CUE_HOP,
+				(AUDIO_CUE_FFT_SIZE - AUDIO_CUE_HOP) * sizeof(float));
+			detector->input_len = AUDIO_CUE_FFT_SIZE - AUDIO_CUE_HOP;
+		}
+	}
+
+	return result;
+}
+
+uint64_t audio_cue_detector_frames(struct audio_cue_detector *detector)
+{
+	return detector->frames;
+}
+
+void audio_cue_detector_bands(struct audio_cue_detector *detector, int8_t *bands)
+{
+	uint32_t pos = (detector->history_pos + AUDIO_CUE_MAX_FRAMES - 1) % AUDIO_CUE_MAX_FRAMES;
+	memcpy(bands, detector->history[pos], AUDIO_CUE_BANDS);
+}
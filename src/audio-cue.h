@@ -0,0 +1,71 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AUDIO_CUE_FFT_SIZE 1024
+#define AUDIO_CUE_HOP 512
+#define AUDIO_CUE_BANDS 16
+// longest cue, about a second at 48 kHz
+#define AUDIO_CUE_MAX_FRAMES 96
+#define AUDIO_CUE_MAX_CUES 16
+#define AUDIO_CUE_TABLE_FILE "ssbu-audio-cues.bin"
+
+/*
+ * Cue table layout:
+ *   char     magic[4]    "AVAC"
+ *   uint32_t version     AUDIO_CUE_TABLE_VERSION (little endian)
+ *   uint32_t num_cues    (little endian)
+ *   num_cues x {
+ *     uint8_t  len; char name[len];
+ *     uint8_t  type;           enum audio_cue_type
+ *     uint16_t num_frames;     (little endian)
+ *     int8_t   bands[num_frames][AUDIO_CUE_BANDS];
+ *   }
+ *
+ * Band values are the energy of log spaced bands between 200 Hz and 8 kHz
+ * relative to the frame's mean, in half dB steps and floored 30 dB below
+ * the loudest band, so the table does not depend on the sample rate, volume
+ * or background noise of the capture.
+ */
+#define AUDIO_CUE_TABLE_MAGIC "AVAC"
+#define AUDIO_CUE_TABLE_VERSION 1
+
+enum audio_cue_type {
+	AUDIO_CUE_NONE,
+	AUDIO_CUE_LOADIN, // load-in screen sound
+	AUDIO_CUE_GO,     // announcer "GO!"
+	AUDIO_CUE_GAME,   // announcer "GAME!"
+};
+
+struct audio_cue_table;
+struct audio_cue_detector;
+
+struct audio_cue_table *audio_cue_table_load(const char *path);
+void audio_cue_table_destroy(struct audio_cue_table *table);
+uint32_t audio_cue_table_size(const struct audio_cue_table *table);
+
+/*
+ * All buffers are allocated up front, audio_cue_detector_process does no
+ * allocation or locking and is safe to call from an audio callback. A
+ * detector must only be fed from one thread.
+ */
+struct audio_cue_detector *audio_cue_detector_create(const struct audio_cue_table *table,
+						     uint32_t sample_rate);
+void audio_cue_detector_destroy(struct audio_cue_detector *detector);
+enum audio_cue_type audio_cue_detector_process(struct audio_cue_detector *detector,
+					       const float *const *planes, uint32_t channels,
+					       uint32_t frames);
+uint64_t audio_cue_detector_frames(struct audio_cue_detector *detector);
+void audio_cue_detector_bands(struct audio_cue_detector *detector, int8_t *bands);
+
+const char *audio_cue_type_name(enum audio_cue_type type);
+enum audio_cue_type audio_cue_type_from_name(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
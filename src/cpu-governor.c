@@ -0,0 +1,247 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <plugin-support.h>
+#include "cpu-governor.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <time.h>
+#include <pthread.h>
+#include <sys/qos.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#define LOW_PRIORITY_NICE 10
+#define MAX_CPUS 64
+
+void cpu_governor_init(struct cpu_governor *gov, uint32_t budget_ms)
+{
+	memset(gov, 0, sizeof(*gov));
+	cpu_governor_set_budget(gov, budget_ms);
+}
+
+void cpu_governor_set_budget(struct cpu_governor *gov, uint32_t budget_ms)
+{
+	gov->budget_ns = (uint64_t)budget_ms * 1000000ULL;
+}
+
+static void refill(struct cpu_governor *gov, uint64_t now)
+{
+	if (!gov->window_start || now < gov->window_start) {
+		gov->window_start = now;
+		return;
+	}
+
+	uint64_t windows = (now - gov->window_start) / CPU_GOVERNOR_WINDOW_NS;
+	uint64_t refund = windows * gov->budget_ns;
+
+	gov->used_ns = gov->used_ns > refund ? gov->used_ns - refund : 0;
+	gov->window_start += windows * CPU_GOVERNOR_WINDOW_NS;
+}
+
+uint64_t cpu_governor_delay(struct cpu_governor *gov, uint64_t now)
+{
+	if (!gov->budget_ns) {
+		return 0;
+	}
+
+	refill(gov, now);
+
+	if (gov->used_ns < gov->budget_ns) {
+		return 0;
+	}
+
+	// wait for enough windows to pay back what was overspent
+	uint64_t windows = (gov->used_ns - gov->budget_ns) / gov->budget_ns;
+	return gov->window_start + (windows + 1) * CPU_GOVERNOR_WINDOW_NS - now;
+}
+
+void cpu_governor_charge(struct cpu_governor *gov, uint64_t cpu_ns)
+{
+	gov->used_ns += cpu_ns;
+	gov->total_ns += cpu_ns;
+}
+
+uint64_t cpu_thread_time_ns(void)
+{
+#ifdef _WIN32
+	FILETIME creation, exited, kernel, user;
+
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exited, &kernel, &user)) {
+		return os_gettime_ns();
+	}
+
+	ULARGE_INTEGER k = {.LowPart = kernel.dwLowDateTime, .HighPart = kernel.dwHighDateTime};
+	ULARGE_INTEGER u = {.LowPart = user.dwLowDateTime, .HighPart = user.dwHighDateTime};
+	return (k.QuadPart + u.QuadPart) * 100;
+#else
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+		return os_gettime_ns();
+	}
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static bool parse_cpu_list(const char *cpus, uint64_t *mask)
+{
+	const char *c = cpus;
+
+	*mask = 0;
+
+	while (*c) {
+		char *end;
+		long first, last;
+
+		while (isspace((unsigned char)*c) || *c == ',')
+			c++;
+		if (!*c)
+			break;
+
+		first = strtol(c, &end, 10);
+		if (end == c)
+			return false;
+		c = end;
+
+		last = first;
+		if (*c == '-') {
+			c++;
+			last = strtol(c, &end, 10);
+			if (end == c)
+				return false;
+			c = end;
+		}
+
+		if (first < 0 || last < first || last >= MAX_CPUS)
+			return false;
+
+		for (long i = first; i <= last; i++) {
+			*mask |= 1ULL << i;
+		}
+	}
+
+	return true;
+}
+
+#if defined(_WIN32)
+
+static bool set_priority(enum worker_priority priority)
+{
+	int value = priority == WORKER_PRIORITY_IDLE  ? THREAD_PRIORITY_IDLE
+		    : priority == WORKER_PRIORITY_LOW ? THREAD_PRIORITY_BELOW_NORMAL
+						      : THREAD_PRIORITY_NORMAL;
+	return SetThreadPriority(GetCurrentThread(), value) != 0;
+}
+
+static bool set_affinity(uint64_t mask)
+{
+	if (!mask) {
+		DWORD_PTR process_mask, system_mask;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+			return false;
+		mask = process_mask;
+	}
+
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+}
+
+#elif defined(__APPLE__)
+
+static bool set_priority(enum worker_priority priority)
+{
+	qos_class_t qos = priority == WORKER_PRIORITY_IDLE  ? QOS_CLASS_BACKGROUND
+			  : priority == WORKER_PRIORITY_LOW ? QOS_CLASS_UTILITY
+							    : QOS_CLASS_DEFAULT;
+	return pthread_set_qos_class_self_np(qos, 0) == 0;
+}
+
+static bool set_affinity(uint64_t mask)
+{
+	// macOS has no hard thread pinning, the QoS class is all we get
+	if (mask) {
+		obs_log(LOG_INFO, "Worker CPU pinning is not supported on macOS");
+	}
+	return true;
+}
+
+#else
+
+static bool set_priority(enum worker_priority priority)
+{
+	struct sched_param param = {0};
+	int policy = priority == WORKER_PRIORITY_IDLE ? SCHED_IDLE : SCHED_OTHER;
+	int nice_value = priority == WORKER_PRIORITY_LOW ? LOW_PRIORITY_NICE : 0;
+
+	int ret = pthread_setschedparam(pthread_self(), policy, &param);
+
+	// nice is per thread on linux, lowering it again needs RLIMIT_NICE headroom
+	if (ret == 0 && policy == SCHED_OTHER &&
+	    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice_value) != 0) {
+		ret = errno;
+	}
+
+	// leaving SCHED_IDLE or a higher nice value is a raise, which an
+	// unprivileged thread may not do, the worker keeps its lower priority
+	if (ret == EPERM || ret == EACCES) {
+		obs_log(LOG_WARNING, "Raising the worker priority needs RLIMIT_NICE headroom, "
+				     "it applies once OBS is restarted");
+	}
+
+	return ret == 0;
+}
+
+static bool set_affinity(uint64_t mask)
+{
+	cpu_set_t set;
+	int cores = os_get_logical_cores();
+
+	CPU_ZERO(&set);
+	for (int i = 0; i < MAX_CPUS && i < CPU_SETSIZE; i++) {
+		if (mask ? (mask & (1ULL << i)) != 0 : i < cores)
+			CPU_SET(i, &set);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+bool cpu_set_thread_policy(enum worker_priority priority, const char *cpus)
+{
+	uint64_t mask = 0;
+	bool success = true;
+
+	if (!set_priority(priority)) {
+		obs_log(LOG_WARNING, "Failed to set worker priority %d", (int)priority);
+		success = false;
+	}
+
+	if (cpus && !parse_cpu_list(cpus, &mask)) {
+		obs_log(LOG_WARNING, "Invalid worker CPU list '%s'", cpus);
+		return false;
+	}
+
+	if (!set_affinity(mask)) {
+		obs_log(LOG_WARNING, "Failed to pin worker to CPUs '%s'", cpus ? cpus : "");
+		success = false;
+	}
+
+	return success;
+}
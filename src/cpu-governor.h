@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CPU_GOVERNOR_WINDOW_NS 1000000000ULL
+
+enum worker_priority {
+	WORKER_PRIORITY_NORMAL,
+	WORKER_PRIORITY_LOW,  // nice 10 / below normal / utility QoS
+	WORKER_PRIORITY_IDLE, // SCHED_IDLE / idle / background QoS
+};
+
+/*
+ * Token bucket over the detection worker's own CPU time: every window
+ * refills budget_ns, work that overran the budget is paid back from the
+ * following windows.
+ */
+struct cpu_governor {
+	uint64_t budget_ns; // 0 = unlimited
+	uint64_t window_start;
+	uint64_t used_ns;
+	uint64_t total_ns;
+	uint32_t deferred;
+	uint32_t shed;
+};
+
+void cpu_governor_init(struct cpu_governor *gov, uint32_t budget_ms);
+void cpu_governor_set_budget(struct cpu_governor *gov, uint32_t budget_ms);
+uint64_t cpu_governor_delay(struct cpu_governor *gov, uint64_t now);
+void cpu_governor_charge(struct cpu_governor *gov, uint64_t cpu_ns);
+
+uint64_t cpu_thread_time_ns(void);
+
+// applies to the calling thread, cpus is a list like "2-3,6" or empty for all
+bool cpu_set_thread_policy(enum worker_priority priority, const char *cpus);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <plugin-support.h>
+#include "event-stream.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#else
+#include <io.h>
+#endif
+
+#define EVENT_RING_SIZE 256
+#define EVENT_LINE_MAX 512
+#define EVENT_MAX_CLIENTS 16
+#define EVENT_ACCEPT_INTERVAL_NS 100000000ULL // 100ms
+#define EVENT_FSYNC_INTERVAL_NS 1000000000ULL // 1s
+
+struct event_stream {
+	pthread_mutex_t mutex;
+	pthread_cond_t cv;
+	pthread_t thread;
+	bool should_run;
+
+	struct event_record ring[EVENT_RING_SIZE];
+	uint32_t head;
+	uint32_t count;
+	uint64_t dropped;
+
+	FILE *log;
+	bool log_dirty;
+	uint64_t last_fsync;
+
+	int listen_fd;
+	int clients[EVENT_MAX_CLIENTS];
+	uint32_t num_clients;
+	char *socket_path;
+};
+
+const char *event_type_name(enum event_type type)
+{
+	switch (type) {
+	case EVENT_GAME_START:
+		return "game_start";
+	case EVENT_GAME_END:
+		return "game_end";
+	case EVENT_CHARACTERS:
+		return "characters";
+	case EVENT_STAGE:
+		return "stage";
+	}
+	return "unknown";
+}
+
+static void copy_string(char *dst, size_t size, const char *src)
+{
+	if (!src) {
+		dst[0] = '\0';
+		return;
+	}
+
+	strncpy(dst, src, size - 1);
+	dst[size - 1] = '\0';
+}
+
+void event_record_from_match(struct event_record *record, const char *source,
+			     const struct ssbu_match_event *event)
+{
+	memset(record, 0, sizeof(*record));
+	record->type = event->type == SSBU_EVENT_GAME_START ? EVENT_GAME_START : EVENT_GAME_END;
+	record->timestamp = event->type == SSBU_EVENT_GAME_START ? event->start : event->end;
+	record->start = event->start;
+	record->end = event->end;
+	copy_string(record->source, sizeof(record->source), source);
+}
+
+void event_record_from_result(struct event_record *record, const char *source,
+			      uint64_t timestamp, const struct ssbu_result *result)
+{
+	memset(record, 0, sizeof(*record));
+	record->type = EVENT_CHARACTERS;
+	record->timestamp = timestamp;
+	copy_string(record->source, sizeof(record->source), source);
+
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		copy_string(record->characters[i], sizeof(record->characters[i]),
+			    result->players[i].character);
+		record->confidence[i] = result->players[i].confidence;
+	}
+}
+
+void event_record_from_stage(struct event_record *record, const char *source, uint64_t timestamp,
+			     const char *stage)
+{
+	memset(record, 0, sizeof(*record));
+	record->type = EVENT_STAGE;
+	record->timestamp = timestamp;
+	copy_string(record->source, sizeof(record->source), source);
+	copy_string(record->stage, sizeof(record->stage), stage);
+}
+
+// every append keeps pos at or below size, pos == size means the line did not fit
+static size_t append_format(char *buf, size_t pos, size_t size, const char *format, ...)
+{
+	va_list args;
+
+	if (pos >= size)
+		return size;
+
+	va_start(args, format);
+	int len = vsnprintf(buf + pos, size - pos, format, args);
+	va_end(args);
+
+	if (len < 0 || (size_t)len >= size - pos)
+		return size;
+	return pos + (size_t)len;
+}
+
+static size_t append_json_string(char *buf, size_t pos, size_t size, const char *str)
+{
+	pos = append_format(buf, pos, size, "\"");
+
+	for (const char *c = str; *c && pos < size; c++) {
+		bool escape = *c == '"' || *c == '\\';
+
+		if ((unsigned char)*c < 0x20)
+			continue;
+		if (pos + (escape ? 2 : 1) >= size)
+			return size;
+
+		if (escape)
+			buf[pos++] = '\\';
+		buf[pos++] = *c;
+	}
+
+	return append_format(buf, pos, size, "\"");
+}
+
+// returns the line length, or 0 when the record does not fit in size
+static size_t format_record(const struct event_record *record, char *buf, size_t size)
+{
+	size_t pos = 0;
+
+	pos = append_format(buf, pos, size, "{\"ts\":%llu,\"event\":\"%s\",\"source\":",
+			    (unsigned long long)record->timestamp, event_type_name(record->type));
+	pos = append_json_string(buf, pos, size, record->source);
+
+	if (record->type == EVENT_CHARACTERS) {
+		pos = append_format(buf, pos, size, ",\"characters\":[");
+		for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+			if (i > 0)
+				pos = append_format(buf, pos, size, ",");
+			if (record->characters[i][0]) {
+				pos = append_json_string(buf, pos, size, record->characters[i]);
+			} else {
+				pos = append_format(buf, pos, size, "null");
+			}
+		}
+
+		pos = append_format(buf, pos, size, "],\"confidence\":[");
+		for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+			pos = append_format(buf, pos, size, "%s%.3f", i > 0 ? "," : "",
+					    record->confidence[i]);
+		}
+		pos = append_format(buf, pos, size, "]");
+	} else if (record->type == EVENT_STAGE) {
+		pos = append_format(buf, pos, size, ",\"stage\":");
+		pos = append_json_string(buf, pos, size, record->stage);
+	} else {
+		pos = append_format(buf, pos, size, ",\"start\":%llu",
+				    (unsigned long long)record->start);
+		if (record->type == EVENT_GAME_END) {
+			pos = append_format(buf, pos, size, ",\"end\":%llu",
+					    (unsigned long long)record->end);
+		}
+	}
+
+	pos = append_format(buf, pos, size, "}\n");
+
+	// a cut off line is not valid json, readers are better off without it
+	return pos < size ? pos : 0;
+}
+
+#ifndef _WIN32
+
+static int open_listen_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		obs_log(LOG_WARNING, "Event socket path too long: %s", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+		obs_log(LOG_WARNING, "Failed to listen on event socket %s: %s", path,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+static void accept_clients(struct event_stream *stream)
+{
+	int fd;
+
+	if (stream->listen_fd < 0) {
+		return;
+	}
+
+	while ((fd = accept(stream->listen_fd, NULL, NULL)) >= 0) {
+		if (stream->num_clients >= EVENT_MAX_CLIENTS) {
+			close(fd);
+			continue;
+		}
+
+		// subscribers that can't keep up get dropped rather than stalling us
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+		stream->clients[stream->num_clients++] = fd;
+	}
+}
+
+static void send_to_clients(struct event_stream *stream, const char *buf, size_t len)
+{
+#ifdef MSG_NOSIGNAL
+	int flags = MSG_NOSIGNAL;
+#else
+	int flags = 0;
+#endif
+
+	for (uint32_t i = 0; i < stream->num_clients;) {
+		ssize_t ret = send(stream->clients[i], buf, len, flags);
+
+		if (ret != (ssize_t)len) {
+			close(stream->clients[i]);
+			stream->clients[i] = stream->clients[--stream->num_clients];
+			continue;
+		}
+		i++;
+	}
+}
+
+static void close_sockets(struct event_stream *stream)
+{
+	for (uint32_t i = 0; i < stream->num_clients; i++) {
+		close(stream->clients[i]);
+	}
+	stream->num_clients = 0;
+
+	if (stream->listen_fd >= 0) {
+		close(stream->listen_fd);
+		unlink(stream->socket_path);
+		stream->listen_fd = -1;
+	}
+}
+
+static void sync_log(FILE *log)
+{
+	fsync(fileno(log));
+}
+
+#else // _WIN32
+
+static int open_listen_socket(const char *path)
+{
+	UNUSED_PARAMETER(path);
+	obs_log(LOG_INFO, "Event socket is not supported on this platform, log only");
+	return -1;
+}
+
+static void accept_clients(struct event_stream *stream)
+{
+	UNUSED_PARAMETER(stream);
+}
+
+static void send_to_clients(struct event_stream *stream, const char *buf, size_t len)
+{
+	UNUSED_PARAMETER(stream);
+	UNUSED_PARAMETER(buf);
+	UNUSED_PARAMETER(len);
+}
+
+static void close_sockets(struct event_stream *stream)
+{
+	UNUSED_PARAMETER(stream);
+}
+
+static void sync_log(FILE *log)
+{
+	_commit(_fileno(log));
+}
+
+#endif // _WIN32
+
+static void write_records(struct event_stream *stream, struct event_record *records, uint32_t count)
+{
+	char line[EVENT_LINE_MAX];
+
+	for (uint32_t i = 0; i < count; i++) {
+		size_t len = format_record(&records[i], line, sizeof(line));
+
+		if (!len) {
+			obs_log(LOG_WARNING, "event record too long for a line, dropped");
+			continue;
+		}
+
+		if (stream->log) {
+			fwrite(line, 1, len, stream->log);
+			stream->log_dirty = true;
+		}
+		send_to_clients(stream, line, len);
+	}
+
+	if (stream->log && count) {
+		fflush(stream->log);
+	}
+}
+
+static void *event_stream_thread(void *data)
+{
+	struct event_stream *stream = data;
+	struct event_record batch[EVENT_RING_SIZE];
+
+	os_set_thread_name("autovod-events");
+
+	pthread_mutex_lock(&stream->mutex);
+
+	while (stream->should_run || stream->count) {
+		if (stream->should_run && !stream->count) {
+			// wake up periodically to pick up new subscribers while idle
+			struct timespec ts;
+			timespec_get(&ts, TIME_UTC);
+			ts.tv_nsec += (long)EVENT_ACCEPT_INTERVAL_NS;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&stream->cv, &stream->mutex, &ts);
+		}
+
+		uint32_t count = stream->count;
+		uint32_t tail = (stream->head + EVENT_RING_SIZE - count) % EVENT_RING_SIZE;
+		for (uint32_t i = 0; i < count; i++) {
+			batch[i] = stream->ring[(tail + i) % EVENT_RING_SIZE];
+		}
+		stream->count = 0;
+		pthread_mutex_unlock(&stream->mutex);
+
+		accept_clients(stream);
+		write_records(stream, batch, count);
+
+		uint64_t now = os_gettime_ns();
+		if (stream->log_dirty && now - stream->last_fsync >= EVENT_FSYNC_INTERVAL_NS) {
+			sync_log(stream->log);
+			stream->log_dirty = false;
+			stream->last_fsync = now;
+		}
+
+		pthread_mutex_lock(&stream->mutex);
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (stream->log && stream->log_dirty) {
+		sync_log(stream->log);
+	}
+
+	return NULL;
+}
+
+struct event_stream *event_stream_create(const char *log_path, const char *socket_path)
+{
+	struct event_stream *stream = bzalloc(sizeof(struct event_stream));
+
+	stream->should_run = true;
+	stream->listen_fd = -1;
+	pthread_mutex_init(&stream->mutex, NULL);
+	pthread_cond_init(&stream->cv, NULL);
+
+	if (log_path) {
+		stream->log = os_fopen(log_path, "ab");
+		if (!stream->log) {
+			obs_log(LOG_WARNING, "Failed to open event log %s", log_path);
+		}
+	}
+
+	if (socket_path) {
+		stream->socket_path = bstrdup(socket_path);
+		stream->listen_fd = open_listen_socket(socket_path);
+	}
+
+	if (pthread_create(&stream->thread, NULL, event_stream_thread, stream) != 0) {
+		obs_log(LOG_ERROR, "failed to create event stream thread");
+		stream->should_run = false;
+		event_stream_destroy(stream);
+		return NULL;
+	}
+
+	obs_log(LOG_INFO, "Event stream started (log: %s, socket: %s)", log_path ? log_path : "none",
+		stream->listen_fd >= 0 ? socket_path : "none");
+	return stream;
+}
+
+void event_stream_destroy(struct event_stream *stream)
+{
+	if (!stream) {
+		return;
+	}
+
+	if (stream->should_run) {
+		pthread_mutex_lock(&stream->mutex);
+		stream->should_run = false;
+		pthread_cond_signal(&stream->cv);
+		pthread_mutex_unlock(&stream->mutex);
+		pthread_join(stream->thread, NULL);
+	}
+
+	if (stream->dropped) {
+		obs_log(LOG_WARNING, "Event stream dropped %llu records",
+			(unsigned long long)stream->dropped);
+	}
+
+	close_sockets(stream);
+	if (stream->log) {
+		fclose(stream->log);
+	}
+
+	pthread_mutex_destroy(&stream->mutex);
+	pthread_cond_destroy(&stream->cv);
+	bfree(stream->socket_path);
+	bfree(stream);
+}
+
+void event_stream_publish(struct event_stream *stream, const struct event_record *record)
+{
+	if (!stream) {
+		return;
+	}
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (stream->count == EVENT_RING_SIZE) {
+		// writer fell behind, overwrite the oldest record
+		stream->count--;
+		stream->dropped++;
+	}
+
+	stream->ring[stream->head] = *record;
+	stream->head = (stream->head + 1) % EVENT_RING_SIZE;
+	stream->count++;
+
+	pthread_cond_signal(&stream->cv);
+	pthread_mutex_unlock(&stream->mutex);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "game-detect/smash-ultimate.h"
+
+#define EVENT_SOURCE_MAX 64
+#define EVENT_CHARACTER_MAX 32
+#define EVENT_STAGE_MAX 32
+
+enum event_type {
+	EVENT_GAME_START,
+	EVENT_GAME_END,
+	EVENT_CHARACTERS,
+	EVENT_STAGE,
+};
+
+struct event_record {
+	enum event_type type;
+	uint64_t timestamp;
+	uint64_t start;
+	uint64_t end;
+	char source[EVENT_SOURCE_MAX];
+	char characters[NUM_SMASH_CHARACTERS][EVENT_CHARACTER_MAX];
+	float confidence[NUM_SMASH_CHARACTERS];
+	char stage[EVENT_STAGE_MAX];
+};
+
+struct event_stream;
+
+/*
+ * Records are appended as JSON lines to log_path and sent to every client
+ * connected to the unix socket at socket_path (either may be NULL). All I/O
+ * happens on the stream's own thread, event_stream_publish only copies the
+ * record into a ring and never blocks on disk or sockets.
+ */
+struct event_stream *event_stream_create(const char *log_path, const char *socket_path);
+void event_stream_destroy(struct event_stream *stream);
+void event_stream_publish(struct event_stream *stream, const struct event_record *record);
+
+void event_record_from_match(struct event_record *record, const char *source,
+			     const struct ssbu_match_event *event);
+void event_record_from_result(struct event_record *record, const char *source,
+			      uint64_t timestamp, const struct ssbu_result *result);
+void event_record_from_stage(struct event_record *record, const char *source, uint64_t timestamp,
+			     const char *stage);
+const char *event_type_name(enum event_type type);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+#include <string.h>
+#include <sys/stat.h>
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <plugin-support.h>
+#include "file-watch.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+#endif
+
+struct file_watch {
+	pthread_t thread;
+	volatile bool should_run;
+	char *path;
+	const char *name;
+	file_watch_cb callback;
+	void *param;
+	int fd; // inotify, -1 when polling
+
+	bool exists;
+	int64_t mtime;
+	int64_t size;
+};
+
+// true when the file looks different from the last call
+static bool stat_changed(struct file_watch *watch)
+{
+	struct stat st;
+	bool exists = os_stat(watch->path, &st) == 0;
+	int64_t mtime = exists ? (int64_t)st.st_mtime : 0;
+	int64_t size = exists ? (int64_t)st.st_size : 0;
+	bool changed = exists != watch->exists || mtime != watch->mtime || size != watch->size;
+
+	watch->exists = exists;
+	watch->mtime = mtime;
+	watch->size = size;
+	return changed;
+}
+
+#ifdef __linux__
+
+// waits up to timeout_ms, true if an event named our file
+static bool wait_inotify(struct file_watch *watch, int timeout_ms)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd pfd = {.fd = watch->fd, .events = POLLIN};
+	bool matched = false;
+
+	if (poll(&pfd, 1, timeout_ms) <= 0) {
+		return false;
+	}
+
+	ssize_t len;
+	while ((len = read(watch->fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len;) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			if (event->len && strcmp(event->name, watch->name) == 0)
+				matched = true;
+			p += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	return matched;
+}
+
+#endif
+
+static bool wait_change(struct file_watch *watch, int timeout_ms)
+{
+#ifdef __linux__
+	if (watch->fd >= 0) {
+		return wait_inotify(watch, timeout_ms);
+	}
+#endif
+	os_sleep_ms((uint32_t)timeout_ms);
+	return stat_changed(watch);
+}
+
+static void *file_watch_thread(void *data)
+{
+	struct file_watch *watch = data;
+
+	os_set_thread_name("autovod-watch");
+
+	while (os_atomic_load_bool(&watch->should_run)) {
+		if (!wait_change(watch, FILE_WATCH_POLL_MS)) {
+			continue;
+		}
+
+		// editors often truncate, write and rename in quick succession
+		while (os_atomic_load_bool(&watch->should_run) &&
+		       wait_change(watch, FILE_WATCH_SETTLE_MS)) {
+		}
+
+		if (os_atomic_load_bool(&watch->should_run)) {
+			obs_log(LOG_INFO, "'%s' changed", watch->path);
+			watch->callback(watch->param);
+		}
+	}
+
+	return NULL;
+}
+
+struct file_watch *file_watch_create(const char *path, file_watch_cb callback, void *param)
+{
+	struct file_watch *watch = bzalloc(sizeof(struct file_watch));
+	const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(path, '\\');
+	if (backslash && (!slash || backslash > slash))
+		slash = backslash;
+#endif
+
+	watch->path = bstrdup(path);
+	watch->name = slash ? watch->path + (slash - path) + 1 : watch->path;
+	watch->callback = callback;
+	watch->param = param;
+	watch->fd = -1;
+	watch->should_run = true;
+	stat_changed(watch);
+
+#ifdef __linux__
+	struct dstr dir = {0};
+	dstr_ncopy(&dir, path, slash ? (size_t)(slash - path) : 0);
+	if (dstr_is_empty(&dir))
+		dstr_copy(&dir, ".");
+
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd >= 0 && inotify_add_watch(watch->fd, dir.array, INOTIFY_MASK) < 0) {
+		// most likely the directory does not exist yet, polling copes with that
+		close(watch->fd);
+		watch->fd = -1;
+	}
+	dstr_free(&dir);
+#endif
+
+	if (pthread_create(&watch->thread, NULL, file_watch_thread, watch) != 0) {
+		obs_log(LOG_ERROR, "failed to create file watch thread");
+		watch->should_run = false;
+		file_watch_destroy(watch);
+		return NULL;
+	}
+
+	return watch;
+}
+
+void file_watch_destroy(struct file_watch *watch)
+{
+	if (!watch) {
+		return;
+	}
+
+	if (os_atomic_load_bool(&watch->should_run)) {
+		os_atomic_set_bool(&watch->should_run, false);
+		pthread_join(watch->thread, NULL);
+	}
+
+#ifdef __linux__
+	if (watch->fd >= 0) {
+		close(watch->fd);
+	}
+#endif
+	bfree(watch->path);
+	bfree(watch);
+}
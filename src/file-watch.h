@@ -0,0 +1,26 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILE_WATCH_POLL_MS 250
+#define FILE_WATCH_SETTLE_MS 100
+
+typedef void (*file_watch_cb)(void *param);
+
+struct file_watch;
+
+/*
+ * Calls callback on the watch's own thread whenever the file is written,
+ * replaced, created or removed. Uses inotify on the parent directory on
+ * linux so editors that save by renaming are caught, and polls the
+ * modification time everywhere else. Bursts of writes are reported once
+ * the file has been quiet for FILE_WATCH_SETTLE_MS.
+ */
+struct file_watch *file_watch_create(const char *path, file_watch_cb callback, void *param);
+void file_watch_destroy(struct file_watch *watch);
+
+#ifdef __cplusplus
+}
+#endif
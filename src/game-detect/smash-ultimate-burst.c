@@ -0,0 +1,315 @@
+#include <string.h>
+#include <obs-module.h>
+#include <util/threading.h>
+#include <plugin-support.h>
+#include "smash-ultimate-burst.h"
+
+struct burst_entry {
+	uint64_t timestamp;
+	float sharpness;
+	size_t offset;
+	uint32_t sizes[NUM_SMASH_CHARACTERS];
+	uint32_t box_width;
+	uint32_t box_height;
+	uint64_t portraits[NUM_SMASH_CHARACTERS];
+	bool has_portraits;
+	bool read;
+};
+
+struct ssbu_burst {
+	pthread_mutex_t mutex;
+	uint8_t *arena;
+	size_t arena_size;
+	size_t head;
+	struct burst_entry entries[SSBU_BURST_MAX_ENTRIES];
+	uint32_t first;
+	uint32_t count;
+
+	// only touched by the pushing thread
+	uint8_t *scratch;
+	size_t scratch_size;
+};
+
+struct ssbu_burst *ssbu_burst_create(size_t budget)
+{
+	struct ssbu_burst *burst = bzalloc(sizeof(struct ssbu_burst));
+
+	pthread_mutex_init(&burst->mutex, NULL);
+	burst->arena_size = budget;
+	return burst;
+}
+
+size_t ssbu_burst_release(struct ssbu_burst *burst)
+{
+	size_t released = burst->scratch_size;
+
+	pthread_mutex_lock(&burst->mutex);
+	if (burst->arena) {
+		released += burst->arena_size;
+	}
+	bfree(burst->arena);
+	burst->arena = NULL;
+	burst->head = 0;
+	burst->first = 0;
+	burst->count = 0;
+	pthread_mutex_unlock(&burst->mutex);
+
+	bfree(burst->scratch);
+	burst->scratch = NULL;
+	burst->scratch_size = 0;
+	return released;
+}
+
+void ssbu_burst_destroy(struct ssbu_burst *burst)
+{
+	if (!burst) {
+		return;
+	}
+
+	pthread_mutex_destroy(&burst->mutex);
+	bfree(burst->arena);
+	bfree(burst->scratch);
+	bfree(burst);
+}
+
+static size_t put_run(uint8_t *out, size_t pos, uint32_t run)
+{
+	while (run >= 0x80) {
+		out[pos++] = (uint8_t)(run | 0x80);
+		run >>= 7;
+	}
+	out[pos++] = (uint8_t)run;
+	return pos;
+}
+
+// alternating runs of background and text pixels, starting with background
+static size_t encode_name_box(struct frame_data *frame, int player, uint8_t text_min,
+			      uint8_t *out, uint64_t *gradient)
+{
+	uint32_t startx, endx, starty, endy;
+	uint32_t run = 0;
+	bool text = false;
+	size_t pos = 0;
+
+	ssbu_name_box_rect(frame->width, frame->height, player, &startx, &endx, &starty, &endy);
+
+	for (uint32_t y = starty; y < endy; y++) {
+		uint8_t *px = &frame->rgba_data[(y * frame->width + startx) * 4];
+		int prev_luma = (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8;
+
+		for (uint32_t x = startx; x < endx; x++, px += 4) {
+			bool is_text = px[0] >= text_min && px[1] >= text_min && px[2] >= text_min;
+			int luma = (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8;
+
+			// text fading in or smeared by motion has weaker edges
+			*gradient += (uint64_t)(luma > prev_luma ? luma - prev_luma : prev_luma - luma);
+			prev_luma = luma;
+
+			if (is_text != text) {
+				pos = put_run(out, pos, run);
+				run = 0;
+				text = is_text;
+			}
+			run++;
+		}
+	}
+
+	return put_run(out, pos, run);
+}
+
+static void decode_name_box(const uint8_t *data, size_t size, uint32_t width, uint32_t height,
+			    struct frame_data *out)
+{
+	uint32_t total = width * height;
+	uint32_t pixel = 0;
+	bool text = false;
+	size_t pos = 0;
+
+	frame_data_init(out, width, height);
+	memset(out->rgba_data, 255, (size_t)total * 4);
+
+	while (pos < size && pixel < total) {
+		uint32_t run = 0;
+		uint32_t shift = 0;
+
+		while (pos < size) {
+			uint8_t byte = data[pos++];
+			run |= (uint32_t)(byte & 0x7f) << shift;
+			shift += 7;
+			if (!(byte & 0x80))
+				break;
+		}
+
+		if (run > total - pixel)
+			run = total - pixel;
+
+		// same polarity as the OCR input, dark text on white
+		if (text) {
+			for (uint32_t i = 0; i < run; i++) {
+				uint8_t *px = &out->rgba_data[(size_t)(pixel + i) * 4];
+				px[0] = px[1] = px[2] = 0;
+			}
+		}
+
+		pixel += run;
+		text = !text;
+	}
+}
+
+static void evict_front(struct ssbu_burst *burst)
+{
+	burst->first = (burst->first + 1) % SSBU_BURST_MAX_ENTRIES;
+	burst->count--;
+}
+
+static struct burst_entry *front(struct ssbu_burst *burst)
+{
+	return &burst->entries[burst->first];
+}
+
+static size_t entry_size(struct burst_entry *entry)
+{
+	size_t size = 0;
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++)
+		size += entry->sizes[i];
+	return size;
+}
+
+static size_t reserve(struct ssbu_burst *burst, size_t size)
+{
+	if (burst->head + size > burst->arena_size) {
+		// entries past the old head are the oldest ones, they go with the wrap
+		while (burst->count && front(burst)->offset >= burst->head)
+			evict_front(burst);
+		burst->head = 0;
+	}
+
+	while (burst->count) {
+		struct burst_entry *entry = front(burst);
+		bool overlaps = entry->offset < burst->head + size &&
+				entry->offset + entry_size(entry) > burst->head;
+
+		if (!overlaps && burst->count < SSBU_BURST_MAX_ENTRIES)
+			break;
+		evict_front(burst);
+	}
+
+	size_t offset = burst->head;
+	burst->head += size;
+	return offset;
+}
+
+void ssbu_burst_push(struct ssbu_burst *burst, struct frame_data *frame, uint64_t timestamp,
+		     bool portraits, const struct ssbu_config *config)
+{
+	uint8_t text_min = config ? config->name_text_min : SSBU_NAME_TEXT_MIN;
+	struct burst_entry entry = {0};
+	uint32_t startx, endx, starty, endy;
+	uint64_t gradient = 0;
+	size_t size = 0;
+
+	ssbu_name_box_rect(frame->width, frame->height, 0, &startx, &endx, &starty, &endy);
+	entry.box_width = endx - startx;
+	entry.box_height = endy - starty;
+
+	// a run costs at least a byte, so a box never encodes larger than its pixel count
+	size_t worst = ((size_t)entry.box_width * entry.box_height + 8) * NUM_SMASH_CHARACTERS;
+	if (burst->scratch_size < worst) {
+		burst->scratch = brealloc(burst->scratch, worst);
+		burst->scratch_size = worst;
+	}
+
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		entry.sizes[i] = (uint32_t)encode_name_box(frame, i, text_min,
+							   burst->scratch + size, &gradient);
+		size += entry.sizes[i];
+	}
+
+	entry.timestamp = timestamp;
+	entry.sharpness = (float)gradient /
+			  (float)(entry.box_width * entry.box_height * NUM_SMASH_CHARACTERS);
+	if (portraits) {
+		for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+			entry.portraits[i] = ssbu_portrait_hash(frame, i);
+		}
+		entry.has_portraits = true;
+	}
+
+	if (size > burst->arena_size) {
+		return;
+	}
+
+	pthread_mutex_lock(&burst->mutex);
+	if (!burst->arena) {
+		burst->arena = bmalloc(burst->arena_size);
+	}
+	entry.offset = reserve(burst, size);
+	memcpy(burst->arena + entry.offset, burst->scratch, size);
+	burst->entries[(burst->first + burst->count) % SSBU_BURST_MAX_ENTRIES] = entry;
+	burst->count++;
+	pthread_mutex_unlock(&burst->mutex);
+}
+
+bool ssbu_burst_take_best(struct ssbu_burst *burst, uint64_t since, struct ssbu_burst_frame *out)
+{
+	struct burst_entry best = {0};
+	uint8_t *data = NULL;
+	bool found = false;
+
+	memset(out, 0, sizeof(*out));
+
+	pthread_mutex_lock(&burst->mutex);
+	for (uint32_t i = 0; i < burst->count; i++) {
+		struct burst_entry *entry =
+			&burst->entries[(burst->first + i) % SSBU_BURST_MAX_ENTRIES];
+
+		if (entry->read || entry->timestamp < since) {
+			continue;
+		}
+
+		if (!found || entry->sharpness > best.sharpness) {
+			best = *entry;
+			found = true;
+		}
+	}
+
+	if (found) {
+		for (uint32_t i = 0; i < burst->count; i++) {
+			struct burst_entry *entry =
+				&burst->entries[(burst->first + i) % SSBU_BURST_MAX_ENTRIES];
+			if (entry->offset == best.offset && entry->timestamp == best.timestamp)
+				entry->read = true;
+		}
+
+		// copy out so decoding happens without holding up the render thread
+		data = bmalloc(entry_size(&best));
+		memcpy(data, burst->arena + best.offset, entry_size(&best));
+	}
+	pthread_mutex_unlock(&burst->mutex);
+
+	if (!found) {
+		return false;
+	}
+
+	size_t offset = 0;
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		decode_name_box(data + offset, best.sizes[i], best.box_width, best.box_height,
+				&out->name_boxes[i]);
+		offset += best.sizes[i];
+		out->portraits[i] = best.portraits[i];
+	}
+
+	out->timestamp = best.timestamp;
+	out->sharpness = best.sharpness;
+	out->has_portraits = best.has_portraits;
+	bfree(data);
+	return true;
+}
+
+void ssbu_burst_frame_free(struct ssbu_burst_frame *frame)
+{
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		if (frame->name_boxes[i].rgba_data)
+			frame_data_destroy(&frame->name_boxes[i]);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "img-utils.h"
+#include "smash-ultimate.h"
+
+#define SSBU_BURST_BUDGET (1024 * 1024)
+#define SSBU_BURST_MAX_ENTRIES 128
+
+/*
+ * Ring of the load-in frames sampled during a capture burst, from the
+ * trigger on, reduced to what the recognizers read: both name boxes
+ * binarized and run length encoded, and the portrait hashes. Nothing
+ * before the trigger is kept. Everything lives in one arena of a fixed
+ * size, the oldest frames are dropped to make room.
+ *
+ * The render thread pushes while the frame is mapped, the worker picks
+ * the sharpest frame afterwards without another readback.
+ *
+ * The arena is allocated by the first push. ssbu_burst_release drops
+ * every frame and gives the memory back, it must be called from the
+ * pushing thread and returns the number of bytes freed.
+ */
+struct ssbu_burst;
+
+struct ssbu_burst_frame {
+	uint64_t timestamp;
+	float sharpness;
+	struct frame_data name_boxes[NUM_SMASH_CHARACTERS];
+	uint64_t portraits[NUM_SMASH_CHARACTERS];
+	bool has_portraits;
+};
+
+struct ssbu_burst *ssbu_burst_create(size_t budget);
+void ssbu_burst_destroy(struct ssbu_burst *burst);
+size_t ssbu_burst_release(struct ssbu_burst *burst);
+void ssbu_burst_push(struct ssbu_burst *burst, struct frame_data *frame, uint64_t timestamp,
+		     bool portraits, const struct ssbu_config *config);
+bool ssbu_burst_take_best(struct ssbu_burst *burst, uint64_t since, struct ssbu_burst_frame *out);
+void ssbu_burst_frame_free(struct ssbu_burst_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
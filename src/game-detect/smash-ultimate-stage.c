@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <string.h>
+#include <obs-module.h>
+#include <plugin-support.h>
+#include "smash-ultimate-stage.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define STAGE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define STAGE_NEON
+#endif
+
+#define STAGE_SAMPLE_STEP 8
+#define STAGE_HIST_SCALE 2
+#define STAGE_MAX_DISTANCE 160
+#define STAGE_NAME_MAX 256
+// stages plus their battlefield and omega forms, with room to spare
+#define STAGE_MAX_STAGES 1024
+
+struct stage_table {
+	char **names;
+	uint8_t *hists; // num_stages * SSBU_STAGE_HIST_BINS
+	uint32_t num_stages;
+};
+
+static struct stage_table *stages = NULL;
+
+static uint32_t hist_distance(const uint8_t *a, const uint8_t *b)
+{
+#if defined(STAGE_SSE2)
+	__m128i acc = _mm_setzero_si128();
+
+	for (uint32_t i = 0; i < SSBU_STAGE_HIST_BINS; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+
+	return (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(STAGE_NEON)
+	uint16x8_t acc = vdupq_n_u16(0);
+
+	for (uint32_t i = 0; i < SSBU_STAGE_HIST_BINS; i += 16) {
+		acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+	}
+
+	return vaddvq_u16(acc);
+#else
+	uint32_t distance = 0;
+
+	for (uint32_t i = 0; i < SSBU_STAGE_HIST_BINS; i++) {
+		distance += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+	}
+
+	return distance;
+#endif
+}
+
+void ssbu_stage_histogram(struct frame_data *frame, uint8_t *hist)
+{
+	uint32_t counts[SSBU_STAGE_HIST_BINS] = {0};
+	uint32_t total = 0;
+
+	// the damage and stock HUD lives in the bottom quarter
+	uint32_t endy = frame->height * 3 / 4;
+
+	for (uint32_t y = 0; y < endy; y += STAGE_SAMPLE_STEP) {
+		uint8_t *row = &frame->rgba_data[y * frame->width * 4];
+
+		for (uint32_t x = 0; x < frame->width; x += STAGE_SAMPLE_STEP) {
+			uint8_t *px = &row[x * 4];
+			counts[((px[0] >> 6) << 4) | ((px[1] >> 6) << 2) | (px[2] >> 6)]++;
+			total++;
+		}
+	}
+
+	for (uint32_t i = 0; i < SSBU_STAGE_HIST_BINS; i++) {
+		uint32_t value = total ? counts[i] * 255 * STAGE_HIST_SCALE / total : 0;
+		hist[i] = (uint8_t)(value > 255 ? 255 : value);
+	}
+}
+
+static bool read_u32(FILE *fp, uint32_t *val)
+{
+	uint8_t buf[4];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf))
+		return false;
+	*val = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+	return true;
+}
+
+static void stage_table_destroy(struct stage_table *table)
+{
+	if (!table) {
+		return;
+	}
+
+	if (table->names) {
+		for (uint32_t i = 0; i < table->num_stages; i++) {
+			bfree(table->names[i]);
+		}
+	}
+
+	bfree(table->names);
+	bfree(table->hists);
+	bfree(table);
+}
+
+static struct stage_table *stage_table_load(const char *filename)
+{
+	struct stage_table *table = NULL;
+	char magic[4];
+	uint32_t version;
+
+	FILE *fp = fopen(filename, "rb");
+	if (!fp) {
+		goto error;
+	}
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+	    memcmp(magic, SSBU_STAGE_TABLE_MAGIC, sizeof(magic)) != 0 ||
+	    !read_u32(fp, &version) || version != SSBU_STAGE_TABLE_VERSION) {
+		goto error;
+	}
+
+	table = bzalloc(sizeof(struct stage_table));
+	if (!read_u32(fp, &table->num_stages) || table->num_stages > STAGE_MAX_STAGES) {
+		goto error;
+	}
+
+	table->names = bzalloc(sizeof(char *) * table->num_stages);
+	table->hists = bzalloc(SSBU_STAGE_HIST_BINS * table->num_stages);
+
+	for (uint32_t i = 0; i < table->num_stages; i++) {
+		uint8_t len;
+
+		if (fread(&len, 1, 1, fp) != 1) {
+			goto error;
+		}
+
+		table->names[i] = bzalloc(len + 1);
+		if (fread(table->names[i], 1, len, fp) != len ||
+		    fread(&table->hists[i * SSBU_STAGE_HIST_BINS], 1, SSBU_STAGE_HIST_BINS, fp) !=
+			    SSBU_STAGE_HIST_BINS) {
+			goto error;
+		}
+	}
+
+	fclose(fp);
+	obs_log(LOG_INFO, "Loaded %u stage signatures", table->num_stages);
+	return table;
+
+error:
+	obs_log(LOG_WARNING, "Failed to load stage table '%s'", filename);
+	if (fp)
+		fclose(fp);
+	stage_table_destroy(table);
+	return NULL;
+}
+
+void ssbu_stage_init(const char *table_path)
+{
+	if (!table_path) {
+		obs_log(LOG_INFO, "No stage table found, stage detection disabled");
+		return;
+	}
+
+	stages = stage_table_load(table_path);
+}
+
+void ssbu_stage_destroy(void)
+{
+	stage_table_destroy(stages);
+	stages = NULL;
+}
+
+bool ssbu_stage_loaded(void)
+{
+	return stages && stages->num_stages;
+}
+
+const char *ssbu_detect_stage(struct frame_data *frame, uint32_t *distance)
+{
+	uint8_t hist[SSBU_STAGE_HIST_BINS];
+	uint32_t best_distance = UINT32_MAX;
+	uint32_t best_idx = 0;
+
+	if (distance) {
+		*distance = UINT32_MAX;
+	}
+
+	if (!stages || !stages->num_stages) {
+		return NULL;
+	}
+
+	ssbu_stage_histogram(frame, hist);
+
+	for (uint32_t i = 0; i < stages->num_stages; i++) {
+		uint32_t dist = hist_distance(hist, &stages->hists[i * SSBU_STAGE_HIST_BINS]);
+
+		if (dist < best_distance) {
+			best_distance = dist;
+			best_idx = i;
+		}
+	}
+
+	if (distance) {
+		*distance = best_distance;
+	}
+
+	if (best_distance > STAGE_MAX_DISTANCE) {
+		return NULL;
+	}
+
+	return stages->names[best_idx];
+}
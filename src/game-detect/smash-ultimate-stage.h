@@ -0,0 +1,36 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "img-utils.h"
+
+// 4 levels per channel of RGB
+#define SSBU_STAGE_HIST_BINS 64
+#define SSBU_STAGE_TABLE_FILE "ssbu-stages.bin"
+
+/*
+ * Stage table layout:
+ *   char    magic[4]     "AVST"
+ *   uint32_t version     SSBU_STAGE_TABLE_VERSION (little endian)
+ *   uint32_t num_stages  (little endian)
+ *   num_stages x { uint8_t len; char name[len]; uint8_t hist[SSBU_STAGE_HIST_BINS]; }
+ */
+#define SSBU_STAGE_TABLE_MAGIC "AVST"
+#define SSBU_STAGE_TABLE_VERSION 1
+
+// seconds after the load-in screen before the stage is fully visible
+#define SSBU_STAGE_DELAY_NS 4000000000ULL
+
+void ssbu_stage_init(const char *table_path);
+void ssbu_stage_destroy(void);
+bool ssbu_stage_loaded(void);
+void ssbu_stage_histogram(struct frame_data *frame, uint8_t *hist);
+const char *ssbu_detect_stage(struct frame_data *frame, uint32_t *distance);
+
+#ifdef __cplusplus
+}
+#endif
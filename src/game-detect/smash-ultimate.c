@@ -1,12 +1,17 @@
 #include <stdlib.h>
 #include <obs-module.h>
+#include <util/threading.h>
 #include <plugin-support.h>
 #include "ocr.h"
+#include "phash.h"
 #include "string-utils.h"
+#include "trace.h"
 #include "smash-ultimate.h"
 
-#define NUM_SMASH_CHARACTERS 2
 #define LEVENSHTIEN_MAX_THRESHOLD 4
+#define PORTRAIT_MAX_DISTANCE 10
+
+static struct phash_index *portrait_index = NULL;
 
 static char *character_list[] = {
 	"MARIO",
@@ -92,7 +97,8 @@ static char *character_list[] = {
 	"PYRA/MYTHRA",
 	"KAZUYA",
 	"SORA",
-	// Mii's cant be recognized since they get separate names
+	// Mii's cant be recognized since they get separate names, the portrait
+	// index carries them instead
 };
 
 static struct expected_pixel_area loadin_screen_detector[] = {
@@ -154,7 +160,81 @@ static struct expected_pixel_area loadin_screen_detector[] = {
 	},
 };
 
-static char *get_character_name(char *text)
+static struct expected_pixel_area game_end_detector[] = {
+	// "GAME!" splash, the letters are drawn over a white flash that
+	// covers the middle band of the screen
+	{
+		// left of the text
+		.rgba = {0xFF, 0xFF, 0xFF, 0xFF},
+		.pixel_threshold = 16,
+		.startx = 240,
+		.endx = 256,
+		.starty = 540,
+		.endy = 541,
+	},
+	{
+		// right of the text
+		.rgba = {0xFF, 0xFF, 0xFF, 0xFF},
+		.pixel_threshold = 16,
+		.startx = 1664,
+		.endx = 1680,
+		.starty = 540,
+		.endy = 541,
+	},
+	{
+		// above the text
+		.rgba = {0xFF, 0xFF, 0xFF, 0xFF},
+		.pixel_threshold = 16,
+		.startx = 960,
+		.endx = 961,
+		.starty = 300,
+		.endy = 308,
+	},
+};
+
+static struct expected_pixel_area results_screen_detector[] = {
+	// BLACK AREAS
+	{
+		// top banner, left
+		.rgba = {0x00, 0x00, 0x00, 0xFF},
+		.pixel_threshold = 10,
+		.startx = 0,
+		.endx = 16,
+		.starty = 8,
+		.endy = 9,
+	},
+	{
+		// top banner, right
+		.rgba = {0x00, 0x00, 0x00, 0xFF},
+		.pixel_threshold = 10,
+		.startx = 1904,
+		.endx = 1920,
+		.starty = 8,
+		.endy = 9,
+	},
+	// GREY AREAS
+	{
+		// bottom bar behind the "ready" prompt
+		.rgba = {0x36, 0x43, 0x48, 0xFF},
+		.pixel_threshold = 10,
+		.startx = 960,
+		.endx = 976,
+		.starty = 1070,
+		.endy = 1071,
+	},
+};
+
+uint32_t ssbu_num_characters(void)
+{
+	return sizeof(character_list) / sizeof(character_list[0]);
+}
+
+const char *ssbu_character_name(uint32_t idx)
+{
+	return idx < ssbu_num_characters() ? character_list[idx] : NULL;
+}
+
+static char *get_character_name(char *text, uint32_t *distance)
 {
 	uint32_t best_idx = 0;
 	uint32_t best_score = UINT32_MAX;
@@ -180,6 +260,7 @@ static char *get_character_name(char *text)
 		return NULL;
 	}
 
+	*distance = best_score;
 	return character_list[best_idx];
 }
 
@@ -195,7 +276,8 @@ static void get_character_name_image(struct frame_data *in_frame, struct frame_d
 			uint8_t g = in_frame->rgba_data[in_index + 1];
 			uint8_t b = in_frame->rgba_data[in_index + 2];
 
-			if (r >= 200 && g >= 200 && b >= 200) {
+			if (r >= SSBU_NAME_TEXT_MIN && g >= SSBU_NAME_TEXT_MIN &&
+			    b >= SSBU_NAME_TEXT_MIN) {
 				// close enough to white becomes black
 				out_frame->rgba_data[out_index + 0] = 0;   // R
 				out_frame->rgba_data[out_index + 1] = 0;   // G
@@ -212,57 +294,615 @@ static void get_character_name_image(struct frame_data *in_frame, struct frame_d
 	}
 }
 
+void ssbu_name_box_rect(uint32_t width, uint32_t height, int player, uint32_t *startx,
+			uint32_t *endx, uint32_t *starty, uint32_t *endy)
+{
+	uint32_t half = width / 2;
+
+	*startx = player * half + width * 1 / 16;
+	*endx = player * half + width * 7 / 16;
+	*starty = 0;
+	*endy = height * 1 / 8;
+}
+
 static void get_character_name_boxes(struct frame_data *in_frame, struct frame_data *out_frames)
 {
-	frame_data_init(&out_frames[0], in_frame->width * 3 / 8, in_frame->height / 8);
-	get_character_name_image(in_frame, &out_frames[0],
-				 in_frame->width * 1 / 16, // startx
-				 in_frame->width * 7 / 16, // endx
-				 0,                        // starty
-				 in_frame->height * 1 / 8  // endy
-	);
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		uint32_t startx, endx, starty, endy;
+
+		ssbu_name_box_rect(in_frame->width, in_frame->height, i, &startx, &endx, &starty,
+				   &endy);
+		frame_data_init(&out_frames[i], endx - startx, endy - starty);
+		get_character_name_image(in_frame, &out_frames[i], startx, endx, starty, endy);
+	}
+}
 
-	frame_data_init(&out_frames[1], in_frame->width * 3 / 8, in_frame->height / 8);
-	get_character_name_image(in_frame, &out_frames[1],
-				 in_frame->width * 9 / 16,  // startx
-				 in_frame->width * 15 / 16, // endx
-				 0,                         // starty
-				 in_frame->height * 1 / 8   // endy
+uint64_t ssbu_portrait_hash(struct frame_data *frame, int player)
+{
+	uint32_t half = frame->width / 2;
+
+	return phash_compute(frame,
+			     player * half + frame->width * 1 / 16, // startx
+			     player * half + frame->width * 7 / 16, // endx
+			     frame->height * 1 / 8,                 // starty
+			     frame->height * 3 / 4                  // endy
 	);
+}
+
+static void get_character_portrait(uint64_t hash, struct ssbu_player *result)
+{
+	struct phash_match match;
+	uint64_t lookup_start = trace_begin();
+	bool found = phash_index_lookup(portrait_index, hash, PORTRAIT_MAX_DISTANCE, &match);
+	trace_end("portrait lookup", lookup_start);
+
+	if (!found) {
+		obs_log(LOG_INFO, "Portrait: %016llx, Result: (null)", (unsigned long long)hash);
+		return;
+	}
+
+	result->character = match.name;
+	result->confidence = 1.0f - (float)match.distance / (float)(PORTRAIT_MAX_DISTANCE + 1);
+	result->recognizer = SSBU_RECOGNIZER_PORTRAIT;
+	obs_log(LOG_INFO, "Portrait: %016llx, Result: %s (costume %u, distance %u)",
+		(unsigned long long)hash, match.name, match.costume, match.distance);
+}
+
+void ssbu_init(const char *portrait_index_path)
+{
+	if (!portrait_index_path) {
+		obs_log(LOG_INFO, "No portrait index found, using OCR only");
+		return;
+	}
+
+	portrait_index = phash_index_load(portrait_index_path);
+}
+
+void ssbu_destroy(void)
+{
+	phash_index_destroy(portrait_index);
+	portrait_index = NULL;
+}
 
-	// for debugging
-	obs_log(LOG_INFO, "Writing PNG files");
-	img_write_png(&out_frames[0], "/Users/Tom/Desktop/character0.png");
-	img_write_png(&out_frames[1], "/Users/Tom/Desktop/character1.png");
-	img_write_png(in_frame, "/Users/Tom/Desktop/both.png");
+// consumes the name boxes
+static void detect_names(struct frame_data *name_boxes, struct ssbu_result *result)
+{
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		uint32_t distance = 0;
+		float word_confidence = 0.0f;
+		uint64_t ocr_start = trace_begin();
+		char *text = ocr_analyze_for_text(&name_boxes[i], &word_confidence);
+		trace_end("ocr", ocr_start);
+		frame_data_destroy(&name_boxes[i]);
+
+		char *character_name = get_character_name(text, &distance);
+		obs_log(LOG_INFO, "Original: %s, Result: %s, Confidence: %.2f", text,
+			character_name, word_confidence);
+		free(text);
+
+		if (character_name) {
+			// a perfect read of a garbled render is still suspect, and a
+			// fuzzy match of a clean one too
+			float match_confidence =
+				1.0f - (float)distance / (float)(LEVENSHTIEN_MAX_THRESHOLD + 1);
+			result->players[i].character = character_name;
+			result->players[i].confidence = word_confidence * match_confidence;
+			result->players[i].recognizer = SSBU_RECOGNIZER_OCR;
+		}
+	}
 }
 
-void ssbu_detect(struct frame_data *frame)
+void ssbu_detect(struct frame_data *frame, const struct ssbu_config *config,
+		 struct ssbu_result *result)
 {
 	struct frame_data name_boxes[NUM_SMASH_CHARACTERS] = {0};
+	enum ssbu_portrait_mode mode = config ? config->portrait_mode : SSBU_PORTRAIT_FALLBACK;
+
+	memset(result, 0, sizeof(*result));
 
 	obs_log(LOG_INFO, "--------------------------------------------------");
 	obs_log(LOG_INFO, "LOADIN SCREEN DETECTED");
-	get_character_name_boxes(frame, name_boxes);
+
+	if (mode != SSBU_PORTRAIT_ONLY || !portrait_index) {
+		get_character_name_boxes(frame, name_boxes);
+		detect_names(name_boxes, result);
+	}
+
+	if (mode == SSBU_PORTRAIT_OFF || !portrait_index) {
+		return;
+	}
 
 	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
-		char *text = ocr_analyze_for_text(&name_boxes[i]);
-		frame_data_destroy(&name_boxes[i]);
+		if (!result->players[i].character) {
+			get_character_portrait(ssbu_portrait_hash(frame, i), &result->players[i]);
+		}
+	}
+}
 
-		char *character_name = get_character_name(text);
-		obs_log(LOG_INFO, "Original: %s, Result: %s", text, character_name);
-		free(text);
+void ssbu_detect_boxes(struct frame_data *name_boxes, const uint64_t *portraits,
+		       const struct ssbu_config *config, struct ssbu_result *result)
+{
+	enum ssbu_portrait_mode mode = config ? config->portrait_mode : SSBU_PORTRAIT_FALLBACK;
+
+	memset(result, 0, sizeof(*result));
+
+	obs_log(LOG_INFO, "--------------------------------------------------");
+	obs_log(LOG_INFO, "LOADIN SCREEN DETECTED");
+
+	if (mode != SSBU_PORTRAIT_ONLY || !portrait_index || !portraits) {
+		detect_names(name_boxes, result);
+	} else {
+		for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+			frame_data_destroy(&name_boxes[i]);
+		}
+	}
+
+	if (mode == SSBU_PORTRAIT_OFF || !portrait_index || !portraits) {
+		return;
+	}
+
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		if (!result->players[i].character) {
+			get_character_portrait(portraits[i], &result->players[i]);
+		}
 	}
 }
 
-bool ssbu_detect_loadin_screen(struct frame_data *frame)
+struct screen_signature {
+	const char *name;
+	enum ssbu_screen screen;
+	struct expected_pixel_area *areas;
+	uint32_t num_areas;
+	bool tuned;
+};
+
+#define SIGNATURE(name, screen, areas, tuned) \
+	{name, screen, areas, sizeof(areas) / sizeof(struct expected_pixel_area), tuned}
+
+// the end screen areas have not been measured on captures yet, they stay off
+// unless a detector file supplies them
+static struct screen_signature signatures[SSBU_NUM_SIGNATURES] = {
+	SIGNATURE("loadin", SSBU_SCREEN_LOADIN, loadin_screen_detector, true),
+	SIGNATURE("game_end", SSBU_SCREEN_GAME_END, game_end_detector, false),
+	SIGNATURE("results", SSBU_SCREEN_RESULTS, results_screen_detector, false),
+};
+
+static uint32_t builtin_num_areas(uint32_t sig)
+{
+	return signatures[sig].tuned ? signatures[sig].num_areas : 0;
+}
+
+void ssbu_config_init(struct ssbu_config *config)
+{
+	memset(config, 0, sizeof(*config));
+
+	for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+		memcpy(config->signatures[sig].areas, signatures[sig].areas,
+		       builtin_num_areas(sig) * sizeof(struct expected_pixel_area));
+		config->signatures[sig].num_areas = builtin_num_areas(sig);
+	}
+	config->name_text_min = SSBU_NAME_TEXT_MIN;
+	config->portrait_mode = SSBU_PORTRAIT_FALLBACK;
+}
+
+static bool load_signature(struct ssbu_signature_config *signature, obs_data_array_t *array)
+{
+	size_t count = obs_data_array_count(array);
+
+	if (!count || count > SSBU_MAX_SIGNATURE_AREAS) {
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		struct expected_pixel_area *area = &signature->areas[i];
+
+		area->rgba[0] = (uint8_t)obs_data_get_int(item, "r");
+		area->rgba[1] = (uint8_t)obs_data_get_int(item, "g");
+		area->rgba[2] = (uint8_t)obs_data_get_int(item, "b");
+		area->rgba[3] = obs_data_has_user_value(item, "a") ? (uint8_t)obs_data_get_int(item, "a")
+								   : 0xFF;
+		area->pixel_threshold = (uint8_t)obs_data_get_int(item, "pixel_threshold");
+		area->max_mismatches = (uint32_t)obs_data_get_int(item, "max_mismatches");
+		area->startx = (uint32_t)obs_data_get_int(item, "startx");
+		area->endx = (uint32_t)obs_data_get_int(item, "endx");
+		area->starty = (uint32_t)obs_data_get_int(item, "starty");
+		area->endy = (uint32_t)obs_data_get_int(item, "endy");
+		obs_data_release(item);
+
+		// same 1080p coordinate space as the built-in signatures
+		if (area->startx >= area->endx || area->endx > 1920 || area->starty >= area->endy ||
+		    area->endy > 1080) {
+			return false;
+		}
+	}
+
+	signature->num_areas = (uint32_t)count;
+	return true;
+}
+
+bool ssbu_config_load(struct ssbu_config *config, const char *path)
+{
+	struct ssbu_config loaded = *config;
+	bool success = true;
+
+	obs_data_t *data = path ? obs_data_create_from_json_file(path) : NULL;
+	if (!data) {
+		return false;
+	}
+
+	obs_data_t *sigs = obs_data_get_obj(data, "signatures");
+	for (uint32_t sig = 0; sigs && sig < SSBU_NUM_SIGNATURES; sig++) {
+		obs_data_array_t *array = obs_data_get_array(sigs, signatures[sig].name);
+
+		if (array && !load_signature(&loaded.signatures[sig], array)) {
+			obs_log(LOG_WARNING, "Invalid '%s' signature in %s", signatures[sig].name,
+				path);
+			success = false;
+		}
+		obs_data_array_release(array);
+	}
+	obs_data_release(sigs);
+	obs_data_release(data);
+
+	// all or nothing, a half applied file would be harder to debug
+	if (success) {
+		*config = loaded;
+	}
+	return success;
+}
+
+static void get_signature_areas(const struct ssbu_config *config, uint32_t sig,
+				const struct expected_pixel_area **areas, uint32_t *num_areas)
+{
+	if (config) {
+		*areas = config->signatures[sig].areas;
+		*num_areas = config->signatures[sig].num_areas;
+	} else {
+		*areas = signatures[sig].areas;
+		*num_areas = builtin_num_areas(sig);
+	}
+}
+
+bool ssbu_config_detects_game_end(const struct ssbu_config *config)
+{
+	const struct expected_pixel_area *areas;
+	uint32_t game_end, results;
+
+	get_signature_areas(config, SSBU_SIGNATURE_GAME_END, &areas, &game_end);
+	get_signature_areas(config, SSBU_SIGNATURE_RESULTS, &areas, &results);
+	return game_end || results;
+}
+
+static uint32_t area_pixels(const struct expected_pixel_area *area)
+{
+	return (area->endx - area->startx) * (area->endy - area->starty);
+}
+
+// areas that reject most often per pixel read go first
+static void reorder_signature(struct ssbu_scan_stats *stats, uint32_t sig,
+			      const struct ssbu_config *config)
+{
+	const struct expected_pixel_area *areas;
+	uint32_t num_areas;
+	double score[SSBU_MAX_SIGNATURE_AREAS];
+	uint8_t *order = stats->order[sig];
+
+	get_signature_areas(config, sig, &areas, &num_areas);
+	if (stats->layout[sig] != num_areas) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < num_areas; i++) {
+		struct ssbu_area_stats *area = &stats->areas[sig][i];
+		double reject_rate = area->evaluated ? (double)area->rejected / area->evaluated : 0.0;
+		score[i] = reject_rate / area_pixels(&areas[i]);
+	}
+
+	for (uint32_t i = 1; i < num_areas; i++) {
+		uint8_t cur = order[i];
+		uint32_t j = i;
+
+		while (j > 0 && score[order[j - 1]] < score[cur]) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = cur;
+	}
+
+	// halve the counts so the order keeps adapting to the current stream
+	for (uint32_t i = 0; i < num_areas; i++) {
+		if (stats->areas[sig][i].evaluated > SSBU_STATS_DECAY_THRESHOLD) {
+			stats->areas[sig][i].evaluated /= 2;
+			stats->areas[sig][i].rejected /= 2;
+		}
+	}
+}
+
+static bool check_signature(struct frame_data *frame, uint32_t sig,
+			    const struct ssbu_config *config, struct ssbu_scan_stats *stats)
 {
-	float matches = 0.0f;
-	uint32_t num_areas = sizeof(loadin_screen_detector) / sizeof(struct expected_pixel_area);
+	const struct expected_pixel_area *areas;
+	uint32_t num_areas;
+	uint32_t pixels_read = 0;
+	bool matched = true;
+
+	get_signature_areas(config, sig, &areas, &num_areas);
+
+	// a replaced config may have a different area count than the stats
+	if (stats && stats->layout[sig] != num_areas) {
+		memset(stats->areas[sig], 0, sizeof(stats->areas[sig]));
+		for (uint32_t i = 0; i < SSBU_MAX_SIGNATURE_AREAS; i++) {
+			stats->order[sig][i] = (uint8_t)i;
+		}
+		stats->layout[sig] = (uint8_t)num_areas;
+	}
+
+	// a disabled signature never matches
+	if (!num_areas) {
+		return false;
+	}
 
 	for (uint32_t i = 0; i < num_areas; i++) {
-		matches += img_check_expected_pixels(frame, &loadin_screen_detector[i]);
+		uint32_t area = stats ? stats->order[sig][i] : i;
+
+		// areas are in 1080p coordinates, a smaller source can't show the screen
+		if (areas[area].endx > frame->width || areas[area].endy > frame->height) {
+			matched = false;
+			break;
+		}
+
+		bool area_matched = img_match_expected_pixels(frame, &areas[area], &pixels_read);
+
+		if (stats) {
+			stats->areas[sig][area].evaluated++;
+			stats->areas[sig][area].rejected += area_matched ? 0 : 1;
+		}
+
+		if (!area_matched) {
+			matched = false;
+			break;
+		}
+	}
+
+	if (stats) {
+		stats->pixels_read += pixels_read;
+	}
+
+	return matched;
+}
+
+void ssbu_scan_stats_init(struct ssbu_scan_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+		for (uint32_t i = 0; i < SSBU_MAX_SIGNATURE_AREAS; i++) {
+			stats->order[sig][i] = (uint8_t)i;
+		}
+		stats->layout[sig] = (uint8_t)builtin_num_areas(sig);
+	}
+}
+
+bool ssbu_scan_stats_load(struct ssbu_scan_stats *stats, const char *path)
+{
+	obs_data_t *data = path ? obs_data_create_from_json_file(path) : NULL;
+	if (!data) {
+		return false;
+	}
+
+	for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+		obs_data_array_t *areas = obs_data_get_array(data, signatures[sig].name);
+		size_t count = obs_data_array_count(areas);
+
+		// stale stats from a different signature layout are useless
+		if (count == stats->layout[sig]) {
+			for (size_t i = 0; i < count; i++) {
+				obs_data_t *area = obs_data_array_item(areas, i);
+				stats->areas[sig][i].evaluated =
+					(uint64_t)obs_data_get_int(area, "evaluated");
+				stats->areas[sig][i].rejected =
+					(uint64_t)obs_data_get_int(area, "rejected");
+				obs_data_release(area);
+			}
+			reorder_signature(stats, sig, NULL);
+		}
+
+		obs_data_array_release(areas);
+	}
+
+	obs_data_release(data);
+	return true;
+}
+
+bool ssbu_scan_stats_save(struct ssbu_scan_stats *stats, const char *path)
+{
+	obs_data_t *data = obs_data_create();
+	bool success;
+
+	for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+		obs_data_array_t *areas = obs_data_array_create();
+
+		for (uint32_t i = 0; i < stats->layout[sig]; i++) {
+			obs_data_t *area = obs_data_create();
+			obs_data_set_int(area, "evaluated", (long long)stats->areas[sig][i].evaluated);
+			obs_data_set_int(area, "rejected", (long long)stats->areas[sig][i].rejected);
+			obs_data_array_push_back(areas, area);
+			obs_data_release(area);
+		}
+
+		obs_data_set_array(data, signatures[sig].name, areas);
+		obs_data_array_release(areas);
+	}
+
+	success = obs_data_save_json_safe(data, path, "tmp", "bak");
+	obs_data_release(data);
+	return success;
+}
+
+double ssbu_scan_stats_pixels_per_frame(struct ssbu_scan_stats *stats)
+{
+	return stats->frames ? (double)stats->pixels_read / (double)stats->frames : 0.0;
+}
+
+bool ssbu_detect_loadin_screen(struct frame_data *frame)
+{
+	return check_signature(frame, SSBU_SIGNATURE_LOADIN, NULL, NULL);
+}
+
+enum ssbu_screen ssbu_detect_screen(struct frame_data *frame, const struct ssbu_config *config,
+				    struct ssbu_scan_stats *stats)
+{
+	enum ssbu_screen screen = SSBU_SCREEN_NONE;
+
+	for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+		if (check_signature(frame, sig, config, stats)) {
+			screen = signatures[sig].screen;
+			break;
+		}
+	}
+
+	if (stats && ++stats->frames % SSBU_REORDER_INTERVAL == 0) {
+		for (uint32_t sig = 0; sig < SSBU_NUM_SIGNATURES; sig++) {
+			reorder_signature(stats, sig, config);
+		}
+	}
+
+	return screen;
+}
+
+void ssbu_vote_reset(struct ssbu_vote *vote)
+{
+	memset(vote, 0, sizeof(*vote));
+}
+
+static struct ssbu_candidate *find_candidate(struct ssbu_player_vote *player, const char *character)
+{
+	for (uint32_t i = 0; i < player->num_candidates; i++) {
+		if (strcmp(player->candidates[i].character, character) == 0) {
+			return &player->candidates[i];
+		}
+	}
+
+	if (player->num_candidates == SSBU_MAX_CANDIDATES) {
+		return NULL;
+	}
+
+	struct ssbu_candidate *candidate = &player->candidates[player->num_candidates++];
+	memset(candidate, 0, sizeof(*candidate));
+	candidate->character = character;
+	return candidate;
+}
+
+static struct ssbu_candidate *best_candidate(struct ssbu_player_vote *player)
+{
+	struct ssbu_candidate *best = NULL;
+
+	for (uint32_t i = 0; i < player->num_candidates; i++) {
+		struct ssbu_candidate *candidate = &player->candidates[i];
+
+		if (!best || candidate->votes > best->votes ||
+		    (candidate->votes == best->votes &&
+		     candidate->total_confidence > best->total_confidence)) {
+			best = candidate;
+		}
+	}
+
+	return best;
+}
+
+bool ssbu_vote_add(struct ssbu_vote *vote, const struct ssbu_result *result,
+		   float confidence_threshold, uint32_t agreement)
+{
+	bool decided = true;
+
+	vote->frames++;
+
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		const struct ssbu_player *player = &result->players[i];
+		struct ssbu_player_vote *player_vote = &vote->players[i];
+
+		if (player->character) {
+			struct ssbu_candidate *candidate =
+				find_candidate(player_vote, player->character);
+
+			if (candidate) {
+				candidate->votes++;
+				candidate->total_confidence += player->confidence;
+				if (player->confidence > candidate->best_confidence) {
+					candidate->best_confidence = player->confidence;
+					candidate->recognizer = player->recognizer;
+				}
+			}
+		}
+
+		struct ssbu_candidate *best = best_candidate(player_vote);
+		if (!best || (best->best_confidence < confidence_threshold && best->votes < agreement)) {
+			decided = false;
+		}
+	}
+
+	return decided;
+}
+
+void ssbu_vote_result(struct ssbu_vote *vote, struct ssbu_result *result)
+{
+	memset(result, 0, sizeof(*result));
+
+	for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+		struct ssbu_candidate *best = best_candidate(&vote->players[i]);
+
+		if (best) {
+			result->players[i].character = best->character;
+			result->players[i].confidence = best->total_confidence / (float)best->votes;
+			result->players[i].recognizer = best->recognizer;
+		}
+	}
+}
+
+uint32_t ssbu_match_update(struct ssbu_match *match, enum ssbu_screen screen, uint64_t timestamp,
+			   struct ssbu_match_event *events)
+{
+	uint32_t num_events = 0;
+
+	if (screen == SSBU_SCREEN_LOADIN) {
+		// a load-in long after the last one means the previous game's end
+		// was missed, close it out before starting the next
+		if (match->in_game && timestamp - match->last_loadin > SSBU_LOADIN_GAP_NS) {
+			events[num_events].type = SSBU_EVENT_GAME_END;
+			events[num_events].start = match->start;
+			events[num_events].end = timestamp;
+			num_events++;
+			match->in_game = false;
+		}
+
+		if (!match->in_game) {
+			match->in_game = true;
+			match->start = timestamp;
+			events[num_events].type = SSBU_EVENT_GAME_START;
+			events[num_events].start = timestamp;
+			events[num_events].end = 0;
+			num_events++;
+		}
+
+		match->last_loadin = timestamp;
+	} else if (screen == SSBU_SCREEN_GAME_END || screen == SSBU_SCREEN_RESULTS) {
+		num_events += ssbu_match_end(match, timestamp, &events[num_events]);
+	}
+
+	return num_events;
+}
+
+uint32_t ssbu_match_end(struct ssbu_match *match, uint64_t timestamp,
+			struct ssbu_match_event *events)
+{
+	if (!match->in_game) {
+		return 0;
 	}
 
-	return matches / (float)num_areas >= 1.0f;
+	match->in_game = false;
+	events[0].type = SSBU_EVENT_GAME_END;
+	events[0].start = match->start;
+	events[0].end = timestamp;
+	return 1;
 }
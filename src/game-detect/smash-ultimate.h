@@ -5,10 +5,161 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "img-utils.h"
 
+#define NUM_SMASH_CHARACTERS 2
+// name text is drawn white, anything with all channels at or above this counts
+#define SSBU_NAME_TEXT_MIN 200
+
+enum ssbu_portrait_mode {
+	SSBU_PORTRAIT_OFF,      // OCR only
+	SSBU_PORTRAIT_FALLBACK, // portrait lookup when OCR fails
+	SSBU_PORTRAIT_ONLY,     // skip OCR entirely
+};
+
+enum ssbu_recognizer {
+	SSBU_RECOGNIZER_NONE,
+	SSBU_RECOGNIZER_OCR,
+	SSBU_RECOGNIZER_PORTRAIT,
+};
+
+enum ssbu_screen {
+	SSBU_SCREEN_NONE,
+	SSBU_SCREEN_LOADIN,
+	SSBU_SCREEN_GAME_END, // "GAME!" splash
+	SSBU_SCREEN_RESULTS,
+};
+
+enum ssbu_event_type {
+	SSBU_EVENT_GAME_START,
+	SSBU_EVENT_GAME_END,
+};
+
+// start and end are frame timestamps in ns, end is 0 for start events
+struct ssbu_match_event {
+	enum ssbu_event_type type;
+	uint64_t start;
+	uint64_t end;
+};
+
+#define SSBU_LOADIN_GAP_NS 30000000000ULL
+#define SSBU_MAX_MATCH_EVENTS 2
+
+struct ssbu_match {
+	bool in_game;
+	uint64_t start;
+	uint64_t last_loadin;
+};
+
+enum ssbu_signature {
+	SSBU_SIGNATURE_LOADIN,
+	SSBU_SIGNATURE_GAME_END,
+	SSBU_SIGNATURE_RESULTS,
+	SSBU_NUM_SIGNATURES,
+};
+
+#define SSBU_MAX_SIGNATURE_AREAS 8
+#define SSBU_REORDER_INTERVAL 1024
+#define SSBU_STATS_DECAY_THRESHOLD (1ULL << 20)
+// per filter, %s is the filter's uuid
+#define SSBU_SCAN_STATS_FILE "scan-stats-%s.json"
+
+struct ssbu_area_stats {
+	uint64_t evaluated;
+	uint64_t rejected;
+};
+
+// per caller rejection statistics used to order signature areas
+struct ssbu_scan_stats {
+	uint64_t frames;
+	uint64_t pixels_read;
+	uint8_t layout[SSBU_NUM_SIGNATURES]; // area count the order was built for
+	uint8_t order[SSBU_NUM_SIGNATURES][SSBU_MAX_SIGNATURE_AREAS];
+	struct ssbu_area_stats areas[SSBU_NUM_SIGNATURES][SSBU_MAX_SIGNATURE_AREAS];
+};
+
+#define SSBU_CONFIG_FILE "detector.json"
+
+struct ssbu_signature_config {
+	struct expected_pixel_area areas[SSBU_MAX_SIGNATURE_AREAS];
+	uint32_t num_areas;
+};
+
+// tunables that can be replaced at runtime, NULL configs mean the built-ins
+struct ssbu_config {
+	struct ssbu_signature_config signatures[SSBU_NUM_SIGNATURES];
+	uint8_t name_text_min;
+	enum ssbu_portrait_mode portrait_mode;
+};
+
+struct ssbu_player {
+	const char *character;
+	float confidence;
+	enum ssbu_recognizer recognizer;
+};
+
+struct ssbu_result {
+	struct ssbu_player players[NUM_SMASH_CHARACTERS];
+};
+
+#define SSBU_PORTRAIT_INDEX_FILE "ssbu-portraits.bin"
+
+#define SSBU_MAX_CANDIDATES 8
+
+struct ssbu_candidate {
+	const char *character;
+	uint32_t votes;
+	float total_confidence;
+	float best_confidence;
+	enum ssbu_recognizer recognizer;
+};
+
+struct ssbu_player_vote {
+	struct ssbu_candidate candidates[SSBU_MAX_CANDIDATES];
+	uint32_t num_candidates;
+};
+
+// accumulates per frame results of one load-in screen
+struct ssbu_vote {
+	struct ssbu_player_vote players[NUM_SMASH_CHARACTERS];
+	uint32_t frames;
+};
+
+void ssbu_init(const char *portrait_index_path);
+void ssbu_destroy(void);
 bool ssbu_detect_loadin_screen(struct frame_data *frame);
-void ssbu_detect(struct frame_data *frame);
+enum ssbu_screen ssbu_detect_screen(struct frame_data *frame, const struct ssbu_config *config,
+				    struct ssbu_scan_stats *stats);
+void ssbu_config_init(struct ssbu_config *config);
+bool ssbu_config_load(struct ssbu_config *config, const char *path);
+// false while the GAME! and results signatures are both disabled
+bool ssbu_config_detects_game_end(const struct ssbu_config *config);
+void ssbu_scan_stats_init(struct ssbu_scan_stats *stats);
+bool ssbu_scan_stats_load(struct ssbu_scan_stats *stats, const char *path);
+bool ssbu_scan_stats_save(struct ssbu_scan_stats *stats, const char *path);
+double ssbu_scan_stats_pixels_per_frame(struct ssbu_scan_stats *stats);
+uint32_t ssbu_match_update(struct ssbu_match *match, enum ssbu_screen screen, uint64_t timestamp,
+			   struct ssbu_match_event *events);
+// ends an open game on a signal other than a scanned frame, such as the
+// "GAME!" audio cue or the session stopping, returns the number of events
+uint32_t ssbu_match_end(struct ssbu_match *match, uint64_t timestamp,
+			struct ssbu_match_event *events);
+void ssbu_detect(struct frame_data *frame, const struct ssbu_config *config,
+		 struct ssbu_result *result);
+// same as ssbu_detect on already binarized name boxes, which it consumes,
+// portraits holds one hash per player or is NULL
+void ssbu_detect_boxes(struct frame_data *name_boxes, const uint64_t *portraits,
+		       const struct ssbu_config *config, struct ssbu_result *result);
+void ssbu_name_box_rect(uint32_t width, uint32_t height, int player, uint32_t *startx,
+			uint32_t *endx, uint32_t *starty, uint32_t *endy);
+void ssbu_vote_reset(struct ssbu_vote *vote);
+bool ssbu_vote_add(struct ssbu_vote *vote, const struct ssbu_result *result,
+		   float confidence_threshold, uint32_t agreement);
+void ssbu_vote_result(struct ssbu_vote *vote, struct ssbu_result *result);
+uint64_t ssbu_portrait_hash(struct frame_data *frame, int player);
+uint32_t ssbu_num_characters(void);
+const char *ssbu_character_name(uint32_t idx);
 
 #ifdef __cplusplus
 }
@@ -3,9 +3,7 @@
 #include <obs-module.h>
 #include <plugin-support.h>
 
-#ifdef __arm64
-
-static bool compare_pixel_colors(uint8_t *color1, uint8_t *color2, uint8_t threshold)
+static bool compare_pixel_colors(const uint8_t *color1, const uint8_t *color2, uint8_t threshold)
 {
 	for (uint32_t i = 0; i < 4; i++) {
 		if (abs(color1[i] - color2[i]) > threshold)
@@ -14,7 +12,7 @@ static bool compare_pixel_colors(uint8_t *color1, uint8_t *color2, uint8_t thres
 	return true;
 }
 
-float img_check_expected_pixels(struct frame_data *frame, struct expected_pixel_area *area)
+float img_check_expected_pixels(struct frame_data *frame, const struct expected_pixel_area *area)
 {
 	uint32_t total_pixels = (area->endx - area->startx) * (area->endy - area->starty);
 	uint32_t matched_pixels = 0;
@@ -33,6 +31,27 @@ float img_check_expected_pixels(struct frame_data *frame, struct expected_pixel_
 	return (float)matched_pixels / (float)total_pixels;
 }
 
+bool img_match_expected_pixels(struct frame_data *frame, const struct expected_pixel_area *area,
+			       uint32_t *pixels_read)
+{
+	uint32_t mismatched_pixels = 0;
+
+	for (uint32_t y = area->starty; y < area->endy; y++) {
+		for (uint32_t x = area->startx; x < area->endx; x++) {
+			uint32_t index = (y * frame->width + x) * 4;
+
+			(*pixels_read)++;
+			if (!compare_pixel_colors(&frame->rgba_data[index], area->rgba,
+						  area->pixel_threshold) &&
+			    ++mismatched_pixels > area->max_mismatches) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 void img_write_png(struct frame_data *frame, const char *filename)
 {
 	FILE *fp = NULL;
@@ -83,23 +102,6 @@ error:
 		fclose(fp);
 }
 
-#else // __arm64
-
-float img_check_expected_pixels(struct frame_data *frame, struct expected_pixel_area *area)
-{
-	(void)frame;
-	(void)area;
-	return 0.0f;
-}
-
-void img_write_png(struct frame_data *frame, const char *filename)
-{
-	(void)frame;
-	(void)filename;
-}
-
-#endif // __arm64
-
 void frame_data_init(struct frame_data *frame, uint32_t width, uint32_t height)
 {
 	frame->width = width;
@@ -1,55 +1,103 @@
 #include <tesseract/capi.h>
 #include <leptonica/allheaders.h>
 #include <obs-module.h>
+#include <util/threading.h>
 #include <plugin-support.h>
 #include "ocr.h"
 #include "string-utils.h"
 #include "img-utils.h"
 
-#ifdef __arm64
-
+// guards tess and every call into it, filters come and go on their own threads
+static pthread_mutex_t engine_mutex = PTHREAD_MUTEX_INITIALIZER;
 static TessBaseAPI *tess = NULL;
+static long engine_users = 0;
 
-void ocr_init(void)
+static TessBaseAPI *load_engine(void)
 {
+	TessBaseAPI *engine;
 	int ret;
 
-	tess = TessBaseAPICreate();
-	if (!tess) {
+	engine = TessBaseAPICreate();
+	if (!engine) {
 		goto error;
 	}
 
-	ret = TessBaseAPIInit3(tess, NULL, "eng");
+	ret = TessBaseAPIInit3(engine, NULL, "eng");
 	if (ret != 0) {
-		obs_log(LOG_ERROR, "Failed to initialize tesseract");
 		goto error;
 	}
 
-	TessBaseAPISetPageSegMode(tess, PSM_SINGLE_BLOCK);
-	TessBaseAPISetSourceResolution(tess, 700);
-	TessBaseAPISetVariable(tess, "language_model_penalty_non_dict_word", "0");
-	TessBaseAPISetVariable(tess, "tessedit_char_whitelist",
+	TessBaseAPISetPageSegMode(engine, PSM_SINGLE_BLOCK);
+	TessBaseAPISetSourceResolution(engine, 700);
+	TessBaseAPISetVariable(engine, "language_model_penalty_non_dict_word", "0");
+	TessBaseAPISetVariable(engine, "tessedit_char_whitelist",
 			       "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789&./- ");
 
-	return;
+	return engine;
 
 error:
 	obs_log(LOG_ERROR, "Failed to initialize tesseract");
-	if (tess) {
-		TessBaseAPIDelete(tess);
-		tess = NULL;
+	if (engine) {
+		TessBaseAPIDelete(engine);
 	}
+	return NULL;
 }
 
-void ocr_destroy(void)
+static void unload_engine(void)
 {
 	TessBaseAPIEnd(tess);
 	TessBaseAPIDelete(tess);
 	tess = NULL;
 }
 
-char *ocr_analyze_for_text(struct frame_data *frame)
+void ocr_init(void)
 {
+	pthread_mutex_lock(&engine_mutex);
+	if (engine_users++ == 0) {
+		tess = load_engine();
+	}
+	pthread_mutex_unlock(&engine_mutex);
+}
+
+void ocr_destroy(void)
+{
+	pthread_mutex_lock(&engine_mutex);
+	if (engine_users > 0 && --engine_users == 0 && tess) {
+		unload_engine();
+		obs_log(LOG_INFO, "OCR engine unloaded");
+	}
+	pthread_mutex_unlock(&engine_mutex);
+}
+
+static float get_word_confidence(void)
+{
+	int *confidences = TessBaseAPIAllWordConfidences(tess);
+	int min_confidence = 0;
+
+	if (!confidences) {
+		return 0.0f;
+	}
+
+	// a name is only as trustworthy as its worst word
+	if (confidences[0] != -1) {
+		min_confidence = 100;
+		for (int *conf = confidences; *conf != -1; conf++) {
+			if (*conf < min_confidence)
+				min_confidence = *conf;
+		}
+	}
+
+	TessDeleteIntArray(confidences);
+	return (float)min_confidence / 100.0f;
+}
+
+char *ocr_analyze_for_text(struct frame_data *frame, float *confidence)
+{
+	char *text = NULL;
+
+	if (confidence)
+		*confidence = 0.0f;
+
 	PIX *pixs = pixCreate(frame->width, frame->height, 32); // 32 for RGBA
 	l_uint32 *lines = pixGetData(pixs);
 
@@ -65,24 +113,18 @@ char *ocr_analyze_for_text(struct frame_data *frame)
 		}
 	}
 
-	TessBaseAPISetImage2(tess, pixs);
-	char *text = TessBaseAPIGetUTF8Text(tess);
-	str_remove_excess_whitespace(text);
+	pthread_mutex_lock(&engine_mutex);
+	if (tess) {
+		TessBaseAPISetImage2(tess, pixs);
+		text = TessBaseAPIGetUTF8Text(tess);
+		if (confidence) {
+			*confidence = get_word_confidence();
+		}
+	}
+	pthread_mutex_unlock(&engine_mutex);
 
+	if (text)
+		str_remove_excess_whitespace(text);
 	pixDestroy(&pixs);
 	return text;
 }
-
-#else // __arm64
-
-void ocr_init(void) {}
-
-void ocr_destroy(void) {}
-
-char *ocr_analyze_for_text(struct frame_data *frame)
-{
-	(void)frame;
-	return NULL;
-}
-
-#endif // __arm64
@@ -7,9 +7,12 @@ extern "C" {
 #include <stdbool.h>
 #include "img-utils.h"
 
+// reference counted, the engine is loaded by the first init and freed by
+// the last destroy. Analysis is serialized on the one shared engine and
+// returns NULL while none is loaded.
 void ocr_init(void);
 void ocr_destroy(void);
-char *ocr_analyze_for_text(struct frame_data *frame);
+char *ocr_analyze_for_text(struct frame_data *frame, float *confidence);
 
 #ifdef __cplusplus
 }
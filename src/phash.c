@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <string.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <plugin-support.h>
+#include "phash.h"
+
+#define PHASH_GRID_W 9
+#define PHASH_GRID_H 8
+#define PHASH_SAMPLES_PER_CELL 4
+#define PHASH_NO_NODE UINT32_MAX
+// name_idx is 16 bits wide
+#define PHASH_MAX_NAMES (UINT16_MAX + 1)
+// on-disk size of a node, names take at least their length byte
+#define PHASH_NODE_BYTES 12
+
+struct phash_node {
+	uint64_t hash;
+	uint16_t name_idx;
+	uint16_t costume;
+	uint32_t parent_distance;
+	uint32_t first_child;
+	uint32_t next_sibling;
+};
+
+struct phash_index {
+	char **names;
+	uint32_t num_names;
+	struct phash_node *nodes;
+	uint32_t num_nodes;
+};
+
+uint32_t phash_distance(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER)
+	return (uint32_t)__popcnt64(a ^ b);
+#else
+	return (uint32_t)__builtin_popcountll(a ^ b);
+#endif
+}
+
+static uint32_t sample_luma(struct frame_data *frame, uint32_t startx, uint32_t endx,
+			    uint32_t starty, uint32_t endy)
+{
+	uint32_t stepx = (endx - startx) / PHASH_SAMPLES_PER_CELL;
+	uint32_t stepy = (endy - starty) / PHASH_SAMPLES_PER_CELL;
+	uint32_t total = 0;
+	uint32_t count = 0;
+
+	if (!stepx)
+		stepx = 1;
+	if (!stepy)
+		stepy = 1;
+
+	for (uint32_t y = starty; y < endy; y += stepy) {
+		for (uint32_t x = startx; x < endx; x += stepx) {
+			uint8_t *px = &frame->rgba_data[(y * frame->width + x) * 4];
+
+			total += (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8;
+			count++;
+		}
+	}
+
+	return count ? total / count : 0;
+}
+
+uint64_t phash_compute(struct frame_data *frame, uint32_t startx, uint32_t endx, uint32_t starty,
+		       uint32_t endy)
+{
+	uint32_t grid[PHASH_GRID_H][PHASH_GRID_W];
+	uint32_t width = endx - startx;
+	uint32_t height = endy - starty;
+	uint64_t hash = 0;
+
+	if (width < PHASH_GRID_W || height < PHASH_GRID_H) {
+		return 0;
+	}
+
+	for (uint32_t gy = 0; gy < PHASH_GRID_H; gy++) {
+		uint32_t y0 = starty + gy * height / PHASH_GRID_H;
+		uint32_t y1 = starty + (gy + 1) * height / PHASH_GRID_H;
+
+		for (uint32_t gx = 0; gx < PHASH_GRID_W; gx++) {
+			uint32_t x0 = startx + gx * width / PHASH_GRID_W;
+			uint32_t x1 = startx + (gx + 1) * width / PHASH_GRID_W;
+
+			grid[gy][gx] = sample_luma(frame, x0, x1, y0, y1);
+		}
+	}
+
+	// difference hash: one bit per horizontal gradient
+	for (uint32_t gy = 0; gy < PHASH_GRID_H; gy++) {
+		for (uint32_t gx = 0; gx < PHASH_GRID_W - 1; gx++) {
+			hash <<= 1;
+			hash |= grid[gy][gx] < grid[gy][gx + 1] ? 1 : 0;
+		}
+	}
+
+	return hash;
+}
+
+static bool read_u8(FILE *fp, uint8_t *val)
+{
+	return fread(val, 1, 1, fp) == 1;
+}
+
+static bool read_u16(FILE *fp, uint16_t *val)
+{
+	uint8_t buf[2];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf))
+		return false;
+	*val = (uint16_t)(buf[0] | (buf[1] << 8));
+	return true;
+}
+
+static bool read_u32(FILE *fp, uint32_t *val)
+{
+	uint8_t buf[4];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf))
+		return false;
+	*val = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+	return true;
+}
+
+static bool read_u64(FILE *fp, uint64_t *val)
+{
+	uint32_t lo, hi;
+	if (!read_u32(fp, &lo) || !read_u32(fp, &hi))
+		return false;
+	*val = (uint64_t)lo | ((uint64_t)hi << 32);
+	return true;
+}
+
+static void bktree_insert(struct phash_index *index, uint32_t node_idx)
+{
+	struct phash_node *node = &index->nodes[node_idx];
+	uint32_t cur = 0;
+
+	while (1) {
+		uint32_t dist = phash_distance(index->nodes[cur].hash, node->hash);
+		uint32_t child = index->nodes[cur].first_child;
+
+		while (child != PHASH_NO_NODE && index->nodes[child].parent_distance != dist) {
+			child = index->nodes[child].next_sibling;
+		}
+
+		if (child == PHASH_NO_NODE) {
+			node->parent_distance = dist;
+			node->next_sibling = index->nodes[cur].first_child;
+			index->nodes[cur].first_child = node_idx;
+			return;
+		}
+
+		cur = child;
+	}
+}
+
+static void bktree_search(struct phash_index *index, uint32_t node_idx, uint64_t hash,
+			  uint32_t *best_distance, uint32_t *best_idx)
+{
+	struct phash_node *node = &index->nodes[node_idx];
+	uint32_t dist = phash_distance(node->hash, hash);
+
+	if (dist < *best_distance) {
+		*best_distance = dist;
+		*best_idx = node_idx;
+		if (dist == 0)
+			return;
+	}
+
+	// triangle inequality: only children within best_distance of dist can improve
+	for (uint32_t child = node->first_child; child != PHASH_NO_NODE;
+	     child = index->nodes[child].next_sibling) {
+		uint32_t child_dist = index->nodes[child].parent_distance;
+		uint32_t lo = dist > *best_distance ? dist - *best_distance : 0;
+		uint32_t hi = dist + *best_distance;
+
+		if (child_dist >= lo && child_dist <= hi) {
+			bktree_search(index, child, hash, best_distance, best_idx);
+			if (*best_distance == 0)
+				return;
+		}
+	}
+}
+
+// bytes left after the current position, -1 if the file can't seek
+static int64_t bytes_left(FILE *fp)
+{
+	int64_t pos = os_ftelli64(fp);
+
+	if (pos < 0 || os_fseeki64(fp, 0, SEEK_END) != 0) {
+		return -1;
+	}
+
+	int64_t end = os_ftelli64(fp);
+	if (os_fseeki64(fp, pos, SEEK_SET) != 0) {
+		return -1;
+	}
+	return end - pos;
+}
+
+struct phash_index *phash_index_load(const char *filename)
+{
+	struct phash_index *index = NULL;
+	char magic[4];
+	uint32_t version;
+	FILE *fp = NULL;
+
+	if (!filename) {
+		goto error;
+	}
+
+	fp = fopen(filename, "rb");
+	if (!fp) {
+		goto error;
+	}
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+	    memcmp(magic, PHASH_INDEX_MAGIC, sizeof(magic)) != 0) {
+		goto error;
+	}
+
+	if (!read_u32(fp, &version) || version != PHASH_INDEX_VERSION) {
+		goto error;
+	}
+
+	index = bzalloc(sizeof(struct phash_index));
+	if (!read_u32(fp, &index->num_names) || !read_u32(fp, &index->num_nodes)) {
+		goto error;
+	}
+
+	// a truncated or corrupt header must not turn into a huge allocation
+	int64_t left = bytes_left(fp);
+	if (left < 0 || index->num_names > PHASH_MAX_NAMES ||
+	    (uint64_t)index->num_names + (uint64_t)index->num_nodes * PHASH_NODE_BYTES >
+		    (uint64_t)left) {
+		goto error;
+	}
+
+	index->names = bzalloc(sizeof(char *) * index->num_names);
+	for (uint32_t i = 0; i < index->num_names; i++) {
+		uint8_t len;
+		if (!read_u8(fp, &len)) {
+			goto error;
+		}
+
+		index->names[i] = bzalloc(len + 1);
+		if (fread(index->names[i], 1, len, fp) != len) {
+			goto error;
+		}
+	}
+
+	index->nodes = bzalloc(sizeof(struct phash_node) * index->num_nodes);
+	for (uint32_t i = 0; i < index->num_nodes; i++) {
+		struct phash_node *node = &index->nodes[i];
+
+		if (!read_u64(fp, &node->hash) || !read_u16(fp, &node->name_idx) ||
+		    !read_u16(fp, &node->costume) || node->name_idx >= index->num_names) {
+			goto error;
+		}
+
+		node->first_child = PHASH_NO_NODE;
+		node->next_sibling = PHASH_NO_NODE;
+
+		if (i > 0) {
+			bktree_insert(index, i);
+		}
+	}
+
+	fclose(fp);
+	obs_log(LOG_INFO, "Loaded %u portrait hashes for %u names", index->num_nodes,
+		index->num_names);
+	return index;
+
+error:
+	obs_log(LOG_WARNING, "Failed to load portrait index '%s'", filename ? filename : "(null)");
+	if (fp)
+		fclose(fp);
+	phash_index_destroy(index);
+	return NULL;
+}
+
+void phash_index_destroy(struct phash_index *index)
+{
+	if (!index) {
+		return;
+	}
+
+	if (index->names) {
+		for (uint32_t i = 0; i < index->num_names; i++) {
+			bfree(index->names[i]);
+		}
+	}
+
+	bfree(index->names);
+	bfree(index->nodes);
+	bfree(index);
+}
+
+size_t phash_index_size(struct phash_index *index)
+{
+	return index ? index->num_nodes : 0;
+}
+
+bool phash_index_lookup(struct phash_index *index, uint64_t hash, uint32_t max_distance,
+			struct phash_match *match)
+{
+	uint32_t best_distance = max_distance + 1;
+	uint32_t best_idx = PHASH_NO_NODE;
+
+	if (!index || !index->num_nodes) {
+		return false;
+	}
+
+	bktree_search(index, 0, hash, &best_distance, &best_idx);
+	if (best_idx == PHASH_NO_NODE) {
+		return false;
+	}
+
+	match->name = index->names[index->nodes[best_idx].name_idx];
+	match->costume = index->nodes[best_idx].costume;
+	match->distance = best_distance;
+	return true;
+}
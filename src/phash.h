@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "img-utils.h"
+
+#define PHASH_BITS 64
+
+/*
+ * Index file layout (little endian):
+ *   char     magic[4]     "AVPH"
+ *   uint32_t version      PHASH_INDEX_VERSION
+ *   uint32_t num_names
+ *   uint32_t num_entries
+ *   num_names   x { uint8_t len; char name[len]; }
+ *   num_entries x { uint64_t hash; uint16_t name_idx; uint16_t costume; }
+ */
+#define PHASH_INDEX_MAGIC "AVPH"
+#define PHASH_INDEX_VERSION 1
+
+struct phash_match {
+	const char *name;
+	uint16_t costume;
+	uint32_t distance;
+};
+
+struct phash_index;
+
+uint64_t phash_compute(struct frame_data *frame, uint32_t startx, uint32_t endx, uint32_t starty,
+		       uint32_t endy);
+uint32_t phash_distance(uint64_t a, uint64_t b);
+
+struct phash_index *phash_index_load(const char *filename);
+void phash_index_destroy(struct phash_index *index);
+size_t phash_index_size(struct phash_index *index);
+bool phash_index_lookup(struct phash_index *index, uint64_t hash, uint32_t max_distance,
+			struct phash_match *match);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,19 +19,93 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <util/platform.h>
 #include <util/threading.h>
+#include <util/dstr.h>
 #include <plugin-support.h>
+#include <float.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include "audio-cue.h"
+#include "cpu-governor.h"
+#include "file-watch.h"
 #include "img-utils.h"
 #include "ocr.h"
+#include "rcu.h"
+#include "trace.h"
+#include "event-stream.h"
+#include "segment-manifest.h"
 #include "game-detect/smash-ultimate.h"
+#include "game-detect/smash-ultimate-burst.h"
+#include "game-detect/smash-ultimate-stage.h"
+
+#ifdef ENABLE_FRONTEND_API
+#include <obs-frontend-api.h>
+#endif
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
 
 #define SETTINGS_OUT_PATH "out_path"
-#define DETECT_INTERVAL 0.05f
-#define CAPTURE_INTERVAL 10.0f
+#define SETTINGS_PORTRAIT_MODE "portrait_mode"
+#define SETTINGS_OCR_MAX_FRAMES "ocr_max_frames"
+#define SETTINGS_OCR_CONFIDENCE "ocr_confidence"
+#define SETTINGS_OCR_AGREEMENT "ocr_agreement"
+#define SETTINGS_AUDIO_PRETRIGGER "audio_pretrigger"
+#define SETTINGS_CPU_BUDGET "cpu_budget_ms"
+#define SETTINGS_WORKER_PRIORITY "worker_priority"
+#define SETTINGS_WORKER_CPUS "worker_cpus"
+#define SETTINGS_TRACE "trace"
+#define SETTINGS_WRITE_TRACE "write_trace"
+#define SETTINGS_DETECTOR_FILE "detector_file"
+#define SETTINGS_NAME_TEXT_MIN "name_text_min"
+#define SETTINGS_DETECT_INTERVAL "detect_interval_ms"
+#define SETTINGS_DETECT_INTERVAL_GAMEPLAY "detect_interval_gameplay_ms"
+#define SETTINGS_CAPTURE_INTERVAL "capture_interval_s"
+#define SETTINGS_IDLE_POLICY "idle_policy"
+#define SETTINGS_IDLE_UNLOAD_OCR "idle_unload_ocr"
+#define DETECT_INTERVAL_MS 50
+#define DETECT_INTERVAL_GAMEPLAY_MS 500
+#define AUDIO_BOOST_NS 8000000000ULL
+#define AUDIO_CONFIRM_NS 10000000000ULL
+#define CAPTURE_INTERVAL_S 10
+#define STAGE_MAX_ATTEMPTS 20
+// how long the source has to stay idle before its resources are released
+#define IDLE_PAUSE_DELAY_S 2.0f
+#define EVENT_LOG_FILE "events.jsonl"
+#define EVENT_SOCKET_FILE "events.sock"
+
+#define PLAN_READER_RENDER 0
+#define PLAN_READER_WORKER 1
+// property callbacks and destroy, which never run at the same time for one filter
+#define PLAN_READER_UI 2
+
+enum idle_policy {
+	IDLE_POLICY_NEVER,
+	IDLE_POLICY_HIDDEN,
+	IDLE_POLICY_OFFLINE,
+};
+
+static struct event_stream *events = NULL;
+static struct audio_cue_table *audio_cues = NULL;
+
+// everything the render pass and the worker take from the settings,
+// compiled once per change and never modified after it is published
+struct autovod_plan {
+	char *out_path;
+	char *detector_file;
+	float detect_interval;
+	float detect_interval_gameplay;
+	float capture_interval;
+	uint32_t ocr_max_frames;
+	float ocr_confidence;
+	uint32_t ocr_agreement;
+	enum idle_policy idle_policy;
+	bool idle_unload_ocr;
+	uint32_t cpu_budget;
+	enum worker_priority worker_priority;
+	char *worker_cpus;
+	struct ssbu_config detector;
+};
 
 struct autovod_ctx {
 	pthread_mutex_t mutex;
@@ -42,23 +116,206 @@ struct autovod_ctx {
 	struct obs_source *source;
 	gs_texrender_t *texrender;
 	gs_stagesurf_t *staging_surface;
-	char *out_path;
+	struct rcu_cell plan;
+	struct file_watch *detector_watch;
+	char *detector_watch_path;
 	uint32_t width;
 	uint32_t height;
 	float seconds_since_last_detect;
 	float seconds_since_last_capture;
-	struct frame_data *capture_frame;
+	struct ssbu_burst *burst;
+	bool capture_pending;
+	uint64_t capture_pending_frame;
+	uint64_t capture_timestamp;
+	bool capture_active;
+	bool capture_expired;
+	struct ssbu_vote vote;
+	struct cpu_governor governor;
+	uint64_t burst_cpu_ns;
+	uint32_t burst_lagged_frames;
+	uint32_t burst_skipped_frames;
+	struct ssbu_match match;
+	uint32_t stage_attempts;
+	struct ssbu_scan_stats scan_stats;
+	struct segment_manifest *manifest;
+	bool manifest_dirty;
+
+	// written by the graphics thread under the mutex, the worker follows
+	bool paused;
+	bool release_ocr;
+	float seconds_idle;
+	uint64_t created_at;
+	uint64_t paused_at;
+	uint64_t idle_ns;
+	uint32_t pauses;
+	volatile bool recording_active;
+	uint64_t recording_starting_at;
+	volatile bool streaming_active;
+
+	volatile bool audio_pretrigger;
+	obs_weak_source_t *audio_parent;
+	struct audio_cue_detector *audio_detector;
+	uint32_t audio_channels;
+	volatile long audio_cue_count;
+	volatile long audio_cue_type;
+	long audio_cue_seen;
+	uint64_t audio_last_cue;
+	enum audio_cue_type audio_last_type;
 };
 
+static void free_plan(void *data)
+{
+	struct autovod_plan *plan = data;
+
+	bfree(plan->out_path);
+	bfree(plan->detector_file);
+	bfree(plan->worker_cpus);
+	bfree(plan);
+}
+
+static struct autovod_plan *compile_plan(obs_data_t *settings)
+{
+	struct autovod_plan *plan = bzalloc(sizeof(struct autovod_plan));
+
+	plan->out_path = bstrdup(obs_data_get_string(settings, SETTINGS_OUT_PATH));
+	plan->detector_file = bstrdup(obs_data_get_string(settings, SETTINGS_DETECTOR_FILE));
+	plan->detect_interval =
+		(float)obs_data_get_int(settings, SETTINGS_DETECT_INTERVAL) / 1000.0f;
+	plan->detect_interval_gameplay =
+		(float)obs_data_get_int(settings, SETTINGS_DETECT_INTERVAL_GAMEPLAY) / 1000.0f;
+	plan->capture_interval = (float)obs_data_get_int(settings, SETTINGS_CAPTURE_INTERVAL);
+	plan->ocr_max_frames = (uint32_t)obs_data_get_int(settings, SETTINGS_OCR_MAX_FRAMES);
+	plan->ocr_confidence = (float)obs_data_get_double(settings, SETTINGS_OCR_CONFIDENCE);
+	plan->ocr_agreement = (uint32_t)obs_data_get_int(settings, SETTINGS_OCR_AGREEMENT);
+	plan->idle_policy = (enum idle_policy)obs_data_get_int(settings, SETTINGS_IDLE_POLICY);
+	plan->idle_unload_ocr = obs_data_get_bool(settings, SETTINGS_IDLE_UNLOAD_OCR);
+	plan->cpu_budget = (uint32_t)obs_data_get_int(settings, SETTINGS_CPU_BUDGET);
+	plan->worker_priority =
+		(enum worker_priority)obs_data_get_int(settings, SETTINGS_WORKER_PRIORITY);
+	plan->worker_cpus = bstrdup(obs_data_get_string(settings, SETTINGS_WORKER_CPUS));
+
+	// a missing or broken file leaves the built-in signatures in place
+	ssbu_config_init(&plan->detector);
+	if (plan->detector_file && *plan->detector_file) {
+		ssbu_config_load(&plan->detector, plan->detector_file);
+	}
+	plan->detector.name_text_min = (uint8_t)obs_data_get_int(settings, SETTINGS_NAME_TEXT_MIN);
+	plan->detector.portrait_mode =
+		(enum ssbu_portrait_mode)obs_data_get_int(settings, SETTINGS_PORTRAIT_MODE);
+
+	return plan;
+}
+
+static void save_session_manifest(struct autovod_ctx *autovod, const char *out_path)
+{
+	struct dstr path = {0};
+
+	// without the frontend api there is no recording to put the manifest
+	// next to, keep a per-source manifest in the destination directory
+	dstr_printf(&path, "%s/%s%s", out_path && *out_path ? out_path : ".",
+		    obs_source_get_name(autovod->source), SEGMENT_MANIFEST_SUFFIX);
+
+	segment_manifest_save(autovod->manifest, path.array, NULL);
+	dstr_free(&path);
+}
+
+// the area order learned on one capture does not fit another, so every
+// filter keeps its own stats under its uuid, which survives renames
+static char *scan_stats_path(struct autovod_ctx *autovod)
+{
+	struct dstr file = {0};
+
+	dstr_printf(&file, SSBU_SCAN_STATS_FILE, obs_source_get_uuid(autovod->source));
+	char *path = obs_module_config_path(file.array);
+	dstr_free(&file);
+	return path;
+}
+
+// a session that stops mid game still gets that game's segment, cut where
+// it stopped, the tracker itself keeps the game open for the next recording
+static void close_open_game(struct autovod_ctx *autovod, struct segment_manifest *manifest,
+			    uint64_t timestamp)
+{
+	struct ssbu_match match = autovod->match;
+	struct ssbu_match_event event;
+
+	if (ssbu_match_end(&match, timestamp, &event)) {
+		segment_manifest_add_event(manifest, &event);
+	}
+}
+
+static void wait_ns(struct autovod_ctx *autovod, uint64_t ns)
+{
+	struct timespec ts;
+
+	timespec_get(&ts, TIME_UTC);
+	ns += (uint64_t)ts.tv_nsec;
+	ts.tv_sec += (time_t)(ns / 1000000000ULL);
+	ts.tv_nsec = (long)(ns % 1000000000ULL);
+	pthread_cond_timedwait(&autovod->cv, &autovod->mutex, &ts);
+}
+
+static bool ocr_wanted(struct autovod_ctx *autovod)
+{
+	return !autovod->paused || !autovod->release_ocr;
+}
+
+// what the worker last applied to itself and its governor
+struct worker_policy {
+	uint32_t cpu_budget;
+	bool thread_set;
+	enum worker_priority priority;
+	char *cpus;
+};
+
+// call with the mutex held, it is dropped while the thread policy changes
+static void apply_worker_policy(struct autovod_ctx *autovod, struct worker_policy *applied)
+{
+	const struct autovod_plan *plan = rcu_read_lock(&autovod->plan, PLAN_READER_WORKER);
+	uint32_t budget = plan->cpu_budget;
+	enum worker_priority priority = plan->worker_priority;
+	bool thread_changed = !applied->thread_set || priority != applied->priority ||
+			      strcmp(plan->worker_cpus, applied->cpus) != 0;
+	if (thread_changed) {
+		bfree(applied->cpus);
+		applied->cpus = bstrdup(plan->worker_cpus);
+	}
+	rcu_read_unlock(&autovod->plan, PLAN_READER_WORKER);
+
+	if (budget != applied->cpu_budget) {
+		applied->cpu_budget = budget;
+		cpu_governor_set_budget(&autovod->governor, budget);
+	}
+
+	if (thread_changed) {
+		applied->thread_set = true;
+		applied->priority = priority;
+		pthread_mutex_unlock(&autovod->mutex);
+
+		cpu_set_thread_policy(priority, applied->cpus);
+		pthread_mutex_lock(&autovod->mutex);
+	}
+}
+
 static void *autovod_thread(void *data)
 {
 	struct autovod_ctx *autovod = data;
+	// the engine is shared, each worker holds it while its filter is active
+	bool ocr_held = false;
+	// a held capture wakes the worker many times, it is only counted once
+	uint64_t deferred_capture = 0;
+	// matches the governor's initial unlimited budget
+	struct worker_policy policy = {0};
+
+	trace_thread_name("autovod worker");
 
 	pthread_mutex_lock(&autovod->mutex);
 	autovod->running = true;
+	apply_worker_policy(autovod, &policy);
 
 	while (1) {
-		while (autovod->should_run && !autovod->capture_frame) {
+		while (autovod->should_run && !autovod->capture_pending && !autovod->capture_expired &&
+		       !autovod->manifest_dirty && ocr_wanted(autovod) == ocr_held) {
 			pthread_cond_wait(&autovod->cv, &autovod->mutex);
 		}
 
@@ -66,33 +323,238 @@ static void *autovod_thread(void *data)
 			break;
 		}
 
-		pthread_mutex_unlock(&autovod->mutex);
-		ssbu_detect(autovod->capture_frame);
-		pthread_mutex_lock(&autovod->mutex);
+		// settings changes apply once there is work, before it is budgeted
+		apply_worker_policy(autovod, &policy);
+
+		if (ocr_wanted(autovod) != ocr_held) {
+			ocr_held = !ocr_held;
+			pthread_mutex_unlock(&autovod->mutex);
+
+			if (ocr_held)
+				ocr_init();
+			else
+				ocr_destroy();
+			pthread_mutex_lock(&autovod->mutex);
+
+			// a resume and a new capture may have come in meanwhile, start over
+			// so a capture is only taken while the hold matches the state
+			continue;
+		}
+
+		uint64_t delay = autovod->capture_pending
+					 ? cpu_governor_delay(&autovod->governor, os_gettime_ns())
+					 : 0;
+
+		if (delay && autovod->vote.frames) {
+			// over budget with a vote already started, settle with what we have
+			autovod->governor.shed++;
+			autovod->capture_pending = false;
+			autovod->capture_expired = true;
+		} else if (delay) {
+			// nothing read for this load-in yet, hold the frame until there is budget
+			if (deferred_capture != autovod->capture_timestamp) {
+				deferred_capture = autovod->capture_timestamp;
+				autovod->governor.deferred++;
+			}
+			uint64_t wait_start = trace_begin();
+			wait_ns(autovod, delay);
+			trace_end("governor wait", wait_start);
+			continue;
+		}
+
+		if (autovod->capture_pending) {
+			const struct autovod_plan *plan =
+				rcu_read_lock(&autovod->plan, PLAN_READER_WORKER);
+			float confidence = plan->ocr_confidence;
+			uint32_t agreement = plan->ocr_agreement;
+			uint32_t max_frames = plan->ocr_max_frames;
+			// OCR can outlast several reloads, keep a copy instead of the reader
+			struct ssbu_config detector = plan->detector;
+			rcu_read_unlock(&autovod->plan, PLAN_READER_WORKER);
+			// only frames of this load-in, the burst starts at its first frame
+			uint64_t since = autovod->capture_timestamp;
+			uint64_t handoff = autovod->capture_pending_frame;
+			autovod->capture_pending = false;
+			pthread_mutex_unlock(&autovod->mutex);
+
+			// the render thread may have pushed several load-in frames since
+			// the last pass, read the sharpest of them
+			struct ssbu_burst_frame frame;
+			struct ssbu_result result;
+			uint64_t cpu_start = cpu_thread_time_ns();
+			uint64_t take_start = trace_begin();
+			trace_frame(handoff);
+			trace_flow_end("capture", handoff);
+			bool found = ssbu_burst_take_best(autovod->burst, since, &frame);
+			trace_end("burst take", take_start);
+			if (found) {
+				uint64_t detect_start = trace_begin();
+				trace_frame(frame.timestamp);
+				ssbu_detect_boxes(frame.name_boxes,
+						  frame.has_portraits ? frame.portraits : NULL,
+						  &detector, &result);
+				ssbu_burst_frame_free(&frame);
+				trace_end("detect", detect_start);
+			}
+			uint64_t cpu_used = cpu_thread_time_ns() - cpu_start;
+			pthread_mutex_lock(&autovod->mutex);
+
+			cpu_governor_charge(&autovod->governor, cpu_used);
+			autovod->burst_cpu_ns += cpu_used;
 
-		frame_data_destroy(autovod->capture_frame);
-		bfree(autovod->capture_frame);
-		autovod->capture_frame = NULL;
+			// stop reading the screen once the vote is settled or out of frames
+			if (found && (ssbu_vote_add(&autovod->vote, &result, confidence, agreement) ||
+				      autovod->vote.frames >= max_frames)) {
+				autovod->capture_expired = true;
+			}
+		}
+
+		if (autovod->capture_expired) {
+			struct ssbu_result result;
+			struct event_record record;
+			uint64_t timestamp = autovod->capture_timestamp;
+
+			ssbu_vote_result(&autovod->vote, &result);
+			obs_log(LOG_INFO, "Characters decided after %u frame(s): %s (%.2f), %s (%.2f)",
+				autovod->vote.frames, result.players[0].character,
+				result.players[0].confidence, result.players[1].character,
+				result.players[1].confidence);
+			obs_log(LOG_INFO,
+				"OCR used %.1f ms CPU, %u render lagged and %u encoder skipped "
+				"frame(s) meanwhile",
+				(double)autovod->burst_cpu_ns / 1e6,
+				obs_get_lagged_frames() - autovod->burst_lagged_frames,
+				video_output_get_skipped_frames(obs_get_video()) -
+					autovod->burst_skipped_frames);
+
+			autovod->capture_expired = false;
+			autovod->capture_active = false;
+			segment_manifest_set_characters(autovod->manifest, timestamp, &result);
+			pthread_mutex_unlock(&autovod->mutex);
+
+			event_record_from_result(&record, obs_source_get_name(autovod->source),
+						 timestamp, &result);
+			event_stream_publish(events, &record);
+			pthread_mutex_lock(&autovod->mutex);
+		}
+
+		if (autovod->manifest_dirty) {
+			autovod->manifest_dirty = false;
+			pthread_mutex_unlock(&autovod->mutex);
+
+			const struct autovod_plan *plan =
+				rcu_read_lock(&autovod->plan, PLAN_READER_WORKER);
+			save_session_manifest(autovod, plan->out_path);
+			rcu_read_unlock(&autovod->plan, PLAN_READER_WORKER);
+			pthread_mutex_lock(&autovod->mutex);
+		}
 	}
 
 	autovod->running = false;
-	if (autovod->capture_frame) {
-		frame_data_destroy(autovod->capture_frame);
-		bfree(autovod->capture_frame);
-		autovod->capture_frame = NULL;
-	}
+	autovod->capture_pending = false;
 	pthread_mutex_unlock(&autovod->mutex);
 
+	if (ocr_held) {
+		ocr_destroy();
+	}
+
+	bfree(policy.cpus);
+	trace_thread_exit();
 	pthread_exit(NULL);
 	return NULL;
 }
 
+#ifdef ENABLE_FRONTEND_API
+static void autovod_frontend_event(enum obs_frontend_event event, void *data)
+{
+	struct autovod_ctx *autovod = data;
+	struct segment_manifest *manifest;
+
+	switch (event) {
+	case OBS_FRONTEND_EVENT_STREAMING_STARTED:
+	case OBS_FRONTEND_EVENT_STREAMING_STOPPED:
+		os_atomic_set_bool(&autovod->streaming_active,
+				   event == OBS_FRONTEND_EVENT_STREAMING_STARTED);
+		break;
+
+	case OBS_FRONTEND_EVENT_RECORDING_STARTING:
+		autovod->recording_starting_at = obs_get_video_frame_time();
+		break;
+
+	case OBS_FRONTEND_EVENT_RECORDING_STARTED: {
+		os_atomic_set_bool(&autovod->recording_active, true);
+
+		// the first frame is encoded between the two events, or with the
+		// frame after the output started, which bounds the base's error
+		uint64_t started_at = obs_get_video_frame_time();
+		uint64_t uncertainty = obs_get_frame_interval_ns();
+		if (autovod->recording_starting_at && autovod->recording_starting_at < started_at)
+			uncertainty += started_at - autovod->recording_starting_at;
+		autovod->recording_starting_at = 0;
+
+		manifest = segment_manifest_create(started_at, uncertainty);
+
+		pthread_mutex_lock(&autovod->mutex);
+		segment_manifest_destroy(autovod->manifest);
+		autovod->manifest = manifest;
+		pthread_mutex_unlock(&autovod->mutex);
+		break;
+	}
+
+	case OBS_FRONTEND_EVENT_RECORDING_STOPPED: {
+		os_atomic_set_bool(&autovod->recording_active, false);
+		pthread_mutex_lock(&autovod->mutex);
+		manifest = autovod->manifest;
+		autovod->manifest = NULL;
+		close_open_game(autovod, manifest, obs_get_video_frame_time());
+		pthread_mutex_unlock(&autovod->mutex);
+
+		char *recording = obs_frontend_get_last_recording();
+		if (manifest && recording) {
+			struct dstr path = {0};
+			dstr_printf(&path, "%s%s", recording, SEGMENT_MANIFEST_SUFFIX);
+			segment_manifest_save(manifest, path.array, recording);
+			dstr_free(&path);
+		}
+
+		bfree(recording);
+		segment_manifest_destroy(manifest);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+#endif
+
 static const char *autovod_plugin_get_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
 	return "Autovod Filter";
 }
 
+static bool write_trace_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	struct autovod_ctx *autovod = data;
+	struct dstr path = {0};
+	char stamp[32];
+	time_t now = time(NULL);
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+
+	const struct autovod_plan *plan = rcu_read_lock(&autovod->plan, PLAN_READER_UI);
+	dstr_printf(&path, "%s/%s%s.json", *plan->out_path ? plan->out_path : ".",
+		    TRACE_FILE_PREFIX, stamp);
+	rcu_read_unlock(&autovod->plan, PLAN_READER_UI);
+
+	trace_write(path.array);
+	dstr_free(&path);
+	return false;
+}
+
 static obs_properties_t *autovod_get_properties(void *data)
 {
 	UNUSED_PARAMETER(data);
@@ -102,32 +564,199 @@ static obs_properties_t *autovod_get_properties(void *data)
 	obs_properties_add_path(props, SETTINGS_OUT_PATH, "Destination", OBS_PATH_DIRECTORY, "*.*",
 				NULL);
 
+	obs_property_t *portrait = obs_properties_add_list(props, SETTINGS_PORTRAIT_MODE,
+							   "Portrait Recognition",
+							   OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(portrait, "Off (OCR only)", SSBU_PORTRAIT_OFF);
+	obs_property_list_add_int(portrait, "Fallback when OCR fails", SSBU_PORTRAIT_FALLBACK);
+	obs_property_list_add_int(portrait, "Portrait only", SSBU_PORTRAIT_ONLY);
+
+	obs_properties_add_int(props, SETTINGS_OCR_MAX_FRAMES, "OCR Frames per Load-in", 1, 30, 1);
+	obs_properties_add_float_slider(props, SETTINGS_OCR_CONFIDENCE, "OCR Confidence Threshold",
+					0.0, 1.0, 0.05);
+	obs_properties_add_int(props, SETTINGS_OCR_AGREEMENT, "OCR Agreeing Frames", 1, 30, 1);
+	obs_properties_add_bool(props, SETTINGS_AUDIO_PRETRIGGER,
+				"Audio Pre-trigger (slower scanning during games)");
+
+	obs_properties_add_int(props, SETTINGS_CPU_BUDGET,
+			       "OCR CPU Budget (ms per second, 0 = unlimited)", 0, 1000, 10);
+	obs_property_t *priority = obs_properties_add_list(props, SETTINGS_WORKER_PRIORITY,
+							   "OCR Thread Priority",
+							   OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(priority, "Normal", WORKER_PRIORITY_NORMAL);
+	obs_property_list_add_int(priority, "Low", WORKER_PRIORITY_LOW);
+	obs_property_list_add_int(priority, "Idle", WORKER_PRIORITY_IDLE);
+	obs_property_set_long_description(
+		priority, "On Linux, going back to a higher priority needs RLIMIT_NICE headroom "
+			  "and otherwise only applies after restarting OBS.");
+	obs_properties_add_text(props, SETTINGS_WORKER_CPUS, "OCR Thread CPUs (e.g. 6-7)",
+				OBS_TEXT_DEFAULT);
+
+	obs_properties_add_path(props, SETTINGS_DETECTOR_FILE, "Detector Signatures (reloaded on save)",
+				OBS_PATH_FILE, "JSON (*.json)", NULL);
+	obs_properties_add_int(props, SETTINGS_NAME_TEXT_MIN, "Name Text Brightness Threshold", 0,
+			       255, 1);
+	obs_properties_add_int(props, SETTINGS_DETECT_INTERVAL, "Detection Interval (ms)", 10, 1000,
+			       10);
+	obs_properties_add_int(props, SETTINGS_DETECT_INTERVAL_GAMEPLAY,
+			       "Detection Interval during Games with Audio (ms)", 10, 5000, 10);
+	obs_properties_add_int(props, SETTINGS_CAPTURE_INTERVAL, "Load-in Capture Cooldown (s)", 1,
+			       120, 1);
+
+	obs_property_t *idle = obs_properties_add_list(props, SETTINGS_IDLE_POLICY,
+						       "Pause Detection", OBS_COMBO_TYPE_LIST,
+						       OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(idle, "Never", IDLE_POLICY_NEVER);
+	obs_property_list_add_int(idle, "When the source is not showing", IDLE_POLICY_HIDDEN);
+#ifdef ENABLE_FRONTEND_API
+	obs_property_list_add_int(idle, "When not showing, recording or streaming",
+				  IDLE_POLICY_OFFLINE);
+#endif
+	obs_properties_add_bool(props, SETTINGS_IDLE_UNLOAD_OCR, "Unload OCR Engine while Paused");
+
+	obs_properties_add_bool(props, SETTINGS_TRACE, "Record Pipeline Trace");
+	obs_properties_add_button(props, SETTINGS_WRITE_TRACE, "Write Trace to Destination",
+				  write_trace_clicked);
+
 	return props;
 }
 
 static void autovod_get_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, SETTINGS_OUT_PATH, "/Users/Tom/Downloads");
+	obs_data_set_default_int(settings, SETTINGS_PORTRAIT_MODE, SSBU_PORTRAIT_FALLBACK);
+	obs_data_set_default_int(settings, SETTINGS_OCR_MAX_FRAMES, 5);
+	obs_data_set_default_double(settings, SETTINGS_OCR_CONFIDENCE, 0.8);
+	obs_data_set_default_int(settings, SETTINGS_OCR_AGREEMENT, 2);
+	obs_data_set_default_bool(settings, SETTINGS_AUDIO_PRETRIGGER, false);
+	obs_data_set_default_int(settings, SETTINGS_CPU_BUDGET, 250);
+	obs_data_set_default_int(settings, SETTINGS_WORKER_PRIORITY, WORKER_PRIORITY_LOW);
+	obs_data_set_default_string(settings, SETTINGS_WORKER_CPUS, "");
+	obs_data_set_default_bool(settings, SETTINGS_TRACE, false);
+	obs_data_set_default_int(settings, SETTINGS_NAME_TEXT_MIN, SSBU_NAME_TEXT_MIN);
+	obs_data_set_default_int(settings, SETTINGS_DETECT_INTERVAL, DETECT_INTERVAL_MS);
+	obs_data_set_default_int(settings, SETTINGS_DETECT_INTERVAL_GAMEPLAY,
+				 DETECT_INTERVAL_GAMEPLAY_MS);
+	obs_data_set_default_int(settings, SETTINGS_CAPTURE_INTERVAL, CAPTURE_INTERVAL_S);
+	obs_data_set_default_int(settings, SETTINGS_IDLE_POLICY, IDLE_POLICY_HIDDEN);
+	obs_data_set_default_bool(settings, SETTINGS_IDLE_UNLOAD_OCR, false);
+
+	char *detector_path = obs_module_config_path(SSBU_CONFIG_FILE);
+	obs_data_set_default_string(settings, SETTINGS_DETECTOR_FILE,
+				    detector_path ? detector_path : "");
+	bfree(detector_path);
+}
+
+// runs on the watch thread whenever the signature file is saved
+static void detector_file_changed(void *data)
+{
+	struct autovod_ctx *autovod = data;
+
+	// a settings update may publish while this compiles, never replace its
+	// plan with one built from the settings read before it
+	bool published;
+	do {
+		long generation = rcu_generation(&autovod->plan);
+		obs_data_t *settings = obs_source_get_settings(autovod->source);
+		published = rcu_publish_if_current(&autovod->plan, compile_plan(settings),
+						   generation);
+		obs_data_release(settings);
+	} while (!published);
 }
 
 static void autovod_on_update(void *data, obs_data_t *settings)
 {
 	struct autovod_ctx *autovod = data;
 
-	const char *out_path = obs_data_get_string(settings, SETTINGS_OUT_PATH);
+	// compiled here, the render and worker threads only ever see whole plans
+	const char *detector_file = obs_data_get_string(settings, SETTINGS_DETECTOR_FILE);
+	obs_log(LOG_INFO, "settings updated: out_path='%s', detector='%s'",
+		obs_data_get_string(settings, SETTINGS_OUT_PATH), detector_file);
 
-	//TODO: check how the memory management works here (out_path is a string)
-	pthread_mutex_lock(&autovod->mutex);
-	autovod->out_path = (char *)out_path;
-	pthread_mutex_unlock(&autovod->mutex);
+	bool watch_changed = !autovod->detector_watch_path ||
+			     strcmp(autovod->detector_watch_path, detector_file) != 0;
+	if (watch_changed) {
+		bfree(autovod->detector_watch_path);
+		autovod->detector_watch_path = bstrdup(detector_file);
+	}
+
+	// the watch thread may publish a plan built from an older read of the
+	// detector file meanwhile, compile again so the file is read after it
+	long generation;
+	do {
+		generation = rcu_generation(&autovod->plan);
+	} while (!rcu_publish_if_current(&autovod->plan, compile_plan(settings), generation));
+
+	if (watch_changed) {
+		file_watch_destroy(autovod->detector_watch);
+		autovod->detector_watch =
+			*autovod->detector_watch_path
+				? file_watch_create(autovod->detector_watch_path,
+						    detector_file_changed, autovod)
+				: NULL;
+	}
+
+	os_atomic_set_bool(&autovod->audio_pretrigger,
+			   obs_data_get_bool(settings, SETTINGS_AUDIO_PRETRIGGER));
+	// one trace for the whole process, the last updated filter decides
+	trace_set_enabled(obs_data_get_bool(settings, SETTINGS_TRACE));
+}
+
+static void autovod_audio_capture(void *data, obs_source_t *source,
+				  const struct audio_data *audio, bool muted)
+{
+	struct autovod_ctx *autovod = data;
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(muted);
+
+	// runs on the audio thread, only touch the detector and atomics here
+	enum audio_cue_type cue = audio_cue_detector_process(autovod->audio_detector,
+							     (const float *const *)audio->data,
+							     autovod->audio_channels, audio->frames);
+
+	if (cue != AUDIO_CUE_NONE) {
+		os_atomic_set_long(&autovod->audio_cue_type, cue);
+		os_atomic_inc_long(&autovod->audio_cue_count);
+	}
+}
+
+static void attach_audio(struct autovod_ctx *autovod)
+{
+	obs_source_t *parent = obs_filter_get_parent(autovod->source);
+	audio_t *audio = obs_get_audio();
+
+	if (!parent || !audio) {
+		return;
+	}
 
-	obs_log(LOG_INFO, "settings updated: out_path='%s'", autovod->out_path);
+	autovod->audio_channels = (uint32_t)audio_output_get_channels(audio);
+	autovod->audio_detector =
+		audio_cue_detector_create(audio_cues, audio_output_get_sample_rate(audio));
+	autovod->audio_parent = obs_source_get_weak_source(parent);
+	obs_source_add_audio_capture_callback(parent, autovod_audio_capture, autovod);
+}
+
+static void detach_audio(struct autovod_ctx *autovod)
+{
+	obs_source_t *parent = obs_weak_source_get_source(autovod->audio_parent);
+
+	if (parent) {
+		obs_source_remove_audio_capture_callback(parent, autovod_audio_capture, autovod);
+		obs_source_release(parent);
+	}
+
+	obs_weak_source_release(autovod->audio_parent);
+	autovod->audio_parent = NULL;
+	audio_cue_detector_destroy(autovod->audio_detector);
+	autovod->audio_detector = NULL;
 }
 
 static void autovod_on_destroy(void *data)
 {
 	struct autovod_ctx *autovod = data;
 
+	file_watch_destroy(autovod->detector_watch);
+
 	if (autovod->thread) {
 		pthread_mutex_lock(&autovod->mutex);
 		autovod->should_run = false;
@@ -138,6 +767,51 @@ static void autovod_on_destroy(void *data)
 		autovod->thread = 0;
 	}
 
+	if (autovod->audio_parent) {
+		detach_audio(autovod);
+	}
+
+#ifdef ENABLE_FRONTEND_API
+	obs_frontend_remove_event_callback(autovod_frontend_event, autovod);
+#else
+	if (autovod->manifest) {
+		close_open_game(autovod, autovod->manifest, obs_get_video_frame_time());
+
+		const struct autovod_plan *plan = rcu_read_lock(&autovod->plan, PLAN_READER_UI);
+		save_session_manifest(autovod, plan->out_path);
+		rcu_read_unlock(&autovod->plan, PLAN_READER_UI);
+	}
+#endif
+	segment_manifest_destroy(autovod->manifest);
+	ssbu_burst_destroy(autovod->burst);
+
+	char *stats_path = scan_stats_path(autovod);
+	if (stats_path && autovod->scan_stats.frames) {
+		ssbu_scan_stats_save(&autovod->scan_stats, stats_path);
+		obs_log(LOG_INFO, "scanned %llu frames, %.1f pixels read per frame",
+			(unsigned long long)autovod->scan_stats.frames,
+			ssbu_scan_stats_pixels_per_frame(&autovod->scan_stats));
+	}
+	bfree(stats_path);
+
+	if (autovod->governor.total_ns) {
+		obs_log(LOG_INFO, "OCR used %.1fs CPU in total, %u frame(s) deferred, %u shed",
+			(double)autovod->governor.total_ns / 1e9, autovod->governor.deferred,
+			autovod->governor.shed);
+	}
+
+	if (autovod->pauses) {
+		uint64_t now = os_gettime_ns();
+		uint64_t lifetime = now - autovod->created_at;
+		uint64_t idle_ns = autovod->idle_ns;
+		if (autovod->paused)
+			idle_ns += now - autovod->paused_at;
+
+		obs_log(LOG_INFO, "paused %u time(s), idle for %.1fs (%.0f%% of %.1fs)",
+			autovod->pauses, (double)idle_ns / 1e9,
+			100.0 * (double)idle_ns / (double)lifetime, (double)lifetime / 1e9);
+	}
+
 	if (autovod->texrender) {
 		obs_enter_graphics();
 		gs_texrender_destroy(autovod->texrender);
@@ -146,6 +820,8 @@ static void autovod_on_destroy(void *data)
 
 	pthread_mutex_destroy(&autovod->mutex);
 	pthread_cond_destroy(&autovod->cv);
+	rcu_cell_free(&autovod->plan);
+	bfree(autovod->detector_watch_path);
 	bfree(autovod);
 
 	obs_log(LOG_INFO, "plugin destroyed successfully");
@@ -168,13 +844,30 @@ static void *autovod_on_create(obs_data_t *settings, obs_source_t *context)
 	autovod->source = context;
 	autovod->should_run = true;
 	autovod->running = false;
+	autovod->created_at = os_gettime_ns();
 	pthread_mutex_init(&autovod->mutex, NULL);
 	pthread_cond_init(&autovod->cv, NULL);
+	cpu_governor_init(&autovod->governor, 0);
+	autovod->burst = ssbu_burst_create(SSBU_BURST_BUDGET);
+	rcu_cell_init(&autovod->plan, compile_plan(settings), free_plan);
+
+	char *stats_path = scan_stats_path(autovod);
+	ssbu_scan_stats_init(&autovod->scan_stats);
+	ssbu_scan_stats_load(&autovod->scan_stats, stats_path);
+	bfree(stats_path);
 
 	obs_enter_graphics();
 	autovod->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
 	obs_leave_graphics();
 
+#ifdef ENABLE_FRONTEND_API
+	autovod->recording_active = obs_frontend_recording_active();
+	autovod->streaming_active = obs_frontend_streaming_active();
+	obs_frontend_add_event_callback(autovod_frontend_event, autovod);
+#else
+	autovod->manifest = segment_manifest_create(os_gettime_ns(), 0);
+#endif
+
 	obs_source_t *target = obs_filter_get_target(autovod->source);
 	signal_handler_t *sh = obs_source_get_signal_handler(target);
 	signal_handler_connect(sh, "remove", source_removed_callback, autovod);
@@ -195,10 +888,134 @@ error:
 	return NULL;
 }
 
+static bool pipeline_idle(struct autovod_ctx *autovod, enum idle_policy policy)
+{
+	obs_source_t *parent = obs_filter_get_parent(autovod->source);
+
+	switch (policy) {
+	case IDLE_POLICY_NEVER:
+		return false;
+	case IDLE_POLICY_OFFLINE:
+#ifdef ENABLE_FRONTEND_API
+		if (!os_atomic_load_bool(&autovod->recording_active) &&
+		    !os_atomic_load_bool(&autovod->streaming_active)) {
+			return true;
+		}
+#endif
+		break;
+	case IDLE_POLICY_HIDDEN:
+		break;
+	}
+
+	return !parent || !obs_source_enabled(autovod->source) || !obs_source_showing(parent);
+}
+
+// drops every per-frame resource, the worker stays parked on the condvar
+static void pause_pipeline(struct autovod_ctx *autovod, bool release_ocr)
+{
+	size_t released = ssbu_burst_release(autovod->burst);
+	size_t surface = (size_t)autovod->width * autovod->height * 4;
+
+	obs_enter_graphics();
+	if (autovod->staging_surface) {
+		gs_stagesurface_destroy(autovod->staging_surface);
+		released += surface;
+	}
+	if (autovod->texrender) {
+		gs_texrender_destroy(autovod->texrender);
+		released += surface;
+	}
+	obs_leave_graphics();
+	autovod->staging_surface = NULL;
+	autovod->texrender = NULL;
+
+	if (autovod->audio_parent) {
+		detach_audio(autovod);
+	}
+
+	pthread_mutex_lock(&autovod->mutex);
+	autovod->width = 0;
+	autovod->height = 0;
+	autovod->paused = true;
+	autovod->release_ocr = release_ocr;
+
+	// the frames of an unfinished load-in went with the burst buffer
+	autovod->capture_pending = false;
+	if (autovod->capture_active && autovod->vote.frames) {
+		autovod->capture_expired = true;
+	} else if (!autovod->capture_expired) {
+		autovod->capture_active = false;
+	}
+	pthread_cond_broadcast(&autovod->cv);
+	pthread_mutex_unlock(&autovod->mutex);
+
+	autovod->paused_at = os_gettime_ns();
+	autovod->pauses++;
+	obs_log(LOG_INFO, "'%s' idle, pipeline paused and %.1f MB released%s",
+		obs_source_get_name(autovod->source), (double)released / (1024.0 * 1024.0),
+		release_ocr ? ", OCR engine released" : "");
+}
+
+static void resume_pipeline(struct autovod_ctx *autovod)
+{
+	uint64_t idle_ns = os_gettime_ns() - autovod->paused_at;
+
+	// the staging surface follows on the size change below
+	obs_enter_graphics();
+	autovod->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	obs_leave_graphics();
+
+	pthread_mutex_lock(&autovod->mutex);
+	autovod->paused = false;
+	autovod->release_ocr = false;
+	pthread_cond_broadcast(&autovod->cv);
+	pthread_mutex_unlock(&autovod->mutex);
+
+	// scan the first frame back instead of waiting out the interval
+	autovod->seconds_since_last_detect = FLT_MAX;
+	autovod->idle_ns += idle_ns;
+	obs_log(LOG_INFO, "'%s' active again after %.1fs, pipeline resumed",
+		obs_source_get_name(autovod->source), (double)idle_ns / 1e9);
+}
+
 static void autovod_on_tick(void *data, float seconds)
 {
 	struct autovod_ctx *autovod = data;
 
+	trace_thread_name("graphics");
+
+	// tick and render take turns on the graphics thread, they share a reader
+	const struct autovod_plan *plan = rcu_read_lock(&autovod->plan, PLAN_READER_RENDER);
+	bool idle = pipeline_idle(autovod, plan->idle_policy);
+	bool release_ocr = plan->idle_unload_ocr;
+	rcu_read_unlock(&autovod->plan, PLAN_READER_RENDER);
+
+	if (!idle) {
+		autovod->seconds_idle = 0;
+		if (autovod->paused)
+			resume_pipeline(autovod);
+	} else if (!autovod->paused) {
+		autovod->seconds_idle += seconds;
+		if (autovod->seconds_idle >= IDLE_PAUSE_DELAY_S)
+			pause_pipeline(autovod, release_ocr);
+	} else if (autovod->release_ocr != release_ocr) {
+		pthread_mutex_lock(&autovod->mutex);
+		autovod->release_ocr = release_ocr;
+		pthread_cond_broadcast(&autovod->cv);
+		pthread_mutex_unlock(&autovod->mutex);
+	}
+
+	if (autovod->paused) {
+		return;
+	}
+
+	bool pretrigger = os_atomic_load_bool(&autovod->audio_pretrigger) && audio_cues;
+	if (pretrigger && !autovod->audio_parent) {
+		attach_audio(autovod);
+	} else if (!pretrigger && autovod->audio_parent) {
+		detach_audio(autovod);
+	}
+
 	obs_source_t *target = obs_filter_get_target(autovod->source);
 
 	if (!target) {
@@ -220,6 +1037,8 @@ static void autovod_on_tick(void *data, float seconds)
 	uint32_t width = obs_source_get_base_width(target);
 	uint32_t height = obs_source_get_base_height(target);
 
+	trace_frame(obs_get_video_frame_time());
+	uint64_t tick_start = trace_begin();
 	pthread_mutex_lock(&autovod->mutex);
 
 	if (width != autovod->width || height != autovod->height) {
@@ -239,6 +1058,109 @@ static void autovod_on_tick(void *data, float seconds)
 	autovod->seconds_since_last_capture += seconds;
 
 	pthread_mutex_unlock(&autovod->mutex);
+	trace_end("tick", tick_start);
+}
+
+static void publish_match_event(struct autovod_ctx *autovod, struct ssbu_match_event *event)
+{
+	struct event_record record;
+
+	event_record_from_match(&record, obs_source_get_name(autovod->source), event);
+	event_stream_publish(events, &record);
+
+	segment_manifest_add_event(autovod->manifest, event);
+#ifndef ENABLE_FRONTEND_API
+	if (event->type == SSBU_EVENT_GAME_END) {
+		autovod->manifest_dirty = true;
+		pthread_cond_broadcast(&autovod->cv);
+	}
+#endif
+
+	if (autovod->audio_last_cue && os_gettime_ns() - autovod->audio_last_cue < AUDIO_CONFIRM_NS) {
+		obs_log(LOG_INFO, "%s confirmed by audio cue '%s'",
+			event->type == SSBU_EVENT_GAME_START ? "game start" : "game end",
+			audio_cue_type_name(autovod->audio_last_type));
+	}
+
+	if (event->type == SSBU_EVENT_GAME_START) {
+		// without a table there is nothing to compare the frames against
+		autovod->stage_attempts = ssbu_stage_loaded() ? STAGE_MAX_ATTEMPTS : 0;
+		obs_log(LOG_INFO, "GAME START at %.3fs", (double)event->start / 1e9);
+	} else {
+		autovod->stage_attempts = 0;
+		obs_log(LOG_INFO, "GAME END at %.3fs (started %.3fs, %.1fs long)",
+			(double)event->end / 1e9, (double)event->start / 1e9,
+			(double)(event->end - event->start) / 1e9);
+	}
+}
+
+static void detect_stage(struct autovod_ctx *autovod, struct frame_data *frame,
+			 uint64_t timestamp)
+{
+	struct event_record record;
+	uint32_t distance = UINT32_MAX;
+
+	const char *stage = ssbu_detect_stage(frame, &distance);
+	autovod->stage_attempts--;
+
+	if (!stage) {
+		if (!autovod->stage_attempts) {
+			obs_log(LOG_INFO, "Stage not recognized (closest distance %u)", distance);
+		}
+		return;
+	}
+
+	autovod->stage_attempts = 0;
+	obs_log(LOG_INFO, "Stage: %s (distance %u)", stage, distance);
+
+	segment_manifest_set_stage(autovod->manifest, timestamp, stage);
+	event_record_from_stage(&record, obs_source_get_name(autovod->source), timestamp, stage);
+	event_stream_publish(events, &record);
+}
+
+// returns true when the audio thread heard a cue since the last call
+static bool poll_audio_cue(struct autovod_ctx *autovod)
+{
+	long cue_count = os_atomic_load_long(&autovod->audio_cue_count);
+
+	if (cue_count == autovod->audio_cue_seen) {
+		return false;
+	}
+
+	autovod->audio_cue_seen = cue_count;
+	autovod->audio_last_cue = os_gettime_ns();
+	autovod->audio_last_type = os_atomic_load_long(&autovod->audio_cue_type);
+	obs_log(LOG_DEBUG, "audio cue '%s'", audio_cue_type_name(autovod->audio_last_type));
+	return true;
+}
+
+static void end_game_on_cue(struct autovod_ctx *autovod)
+{
+	struct ssbu_match_event event;
+
+	pthread_mutex_lock(&autovod->mutex);
+	if (ssbu_match_end(&autovod->match, obs_get_video_frame_time(), &event)) {
+		publish_match_event(autovod, &event);
+	}
+	pthread_mutex_unlock(&autovod->mutex);
+}
+
+static float detect_interval(struct autovod_ctx *autovod, const struct autovod_plan *plan)
+{
+	uint64_t now = os_gettime_ns();
+
+	// gameplay between cues only needs to catch the "GAME!" splash, which
+	// stays up long enough for a slow scan, so skip most readbacks there
+	if (!autovod->audio_parent || !autovod->match.in_game || autovod->capture_active ||
+	    autovod->stage_attempts) {
+		return plan->detect_interval;
+	}
+
+	if (autovod->audio_last_cue && now - autovod->audio_last_cue < AUDIO_BOOST_NS) {
+		return plan->detect_interval;
+	}
+
+	return plan->detect_interval_gameplay;
 }
 
 static void autovod_on_render(void *data, gs_effect_t *unused_effect)
@@ -246,17 +1168,35 @@ static void autovod_on_render(void *data, gs_effect_t *unused_effect)
 	struct autovod_ctx *autovod = data;
 	UNUSED_PARAMETER(unused_effect);
 
-	bool detect_cooldown = autovod->seconds_since_last_detect >= DETECT_INTERVAL;
-	bool capture_cooldown = autovod->seconds_since_last_capture >= CAPTURE_INTERVAL;
+	// held for the whole pass, a reconfiguration never waits on it
+	const struct autovod_plan *plan = rcu_read_lock(&autovod->plan, PLAN_READER_RENDER);
+
+	// until a detector file enables an end screen, the announcer's "GAME!"
+	// is the only end signal for a game short of the next load-in
+	if (poll_audio_cue(autovod) && autovod->audio_last_type == AUDIO_CUE_GAME &&
+	    !ssbu_config_detects_game_end(&plan->detector)) {
+		end_game_on_cue(autovod);
+	}
+
+	bool detect_cooldown = autovod->seconds_since_last_detect >= detect_interval(autovod, plan);
+	bool capture_cooldown = autovod->seconds_since_last_capture >= plan->capture_interval;
+	// without end screens to look for, nothing needs a readback between load-ins
+	bool scan_needed = capture_cooldown || autovod->capture_active || autovod->stage_attempts ||
+			   ssbu_config_detects_game_end(&plan->detector);
 	obs_source_t *target = obs_filter_get_target(autovod->source);
 	obs_source_t *parent = obs_filter_get_parent(autovod->source);
 
-	if (!parent || !autovod->width || !autovod->height || !detect_cooldown ||
-	    !capture_cooldown) {
+	if (!parent || autovod->paused || !autovod->width || !autovod->height || !detect_cooldown ||
+	    !scan_needed) {
+		rcu_read_unlock(&autovod->plan, PLAN_READER_RENDER);
 		obs_source_skip_video_filter(autovod->source);
 		return;
 	}
 
+	trace_frame(obs_get_video_frame_time());
+	uint64_t render_start = trace_begin();
+	uint64_t texrender_start = trace_begin();
+
 	gs_texrender_reset(autovod->texrender);
 
 	if (gs_texrender_begin(autovod->texrender, autovod->width, autovod->height)) {
@@ -281,16 +1221,26 @@ static void autovod_on_render(void *data, gs_effect_t *unused_effect)
 		gs_blend_state_pop();
 		gs_texrender_end(autovod->texrender);
 	}
+	trace_end("texrender", texrender_start);
 
 	gs_texture_t *tex = gs_texrender_get_texture(autovod->texrender);
 	if (tex) {
+		uint64_t stage_start = trace_begin();
 		gs_stage_texture(autovod->staging_surface, tex);
+		trace_end("stage texture", stage_start);
 
 		uint8_t *data;
 		uint32_t linesize;
 
+		uint64_t lock_start = trace_begin();
 		pthread_mutex_lock(&autovod->mutex);
-		if (gs_stagesurface_map(autovod->staging_surface, &data, &linesize)) {
+		trace_end("render lock", lock_start);
+
+		uint64_t map_start = trace_begin();
+		bool mapped = gs_stagesurface_map(autovod->staging_surface, &data, &linesize);
+		trace_end("map", map_start);
+
+		if (mapped) {
 			//TODO: handle case where linesize != width * 4
 			//		handle case where image isnt processed before next frame
 			//		goto error handling if allocating fails
@@ -301,13 +1251,58 @@ static void autovod_on_render(void *data, gs_effect_t *unused_effect)
 				.height = autovod->height,
 			};
 
-			if (ssbu_detect_loadin_screen(&tmp_frame)) {
-				struct frame_data *frame = bzalloc(sizeof(struct frame_data));
-				frame_data_init(frame, autovod->width, autovod->height);
+			struct ssbu_match_event match_events[SSBU_MAX_MATCH_EVENTS];
+			uint64_t signature_start = trace_begin();
+			enum ssbu_screen screen =
+				ssbu_detect_screen(&tmp_frame, &plan->detector, &autovod->scan_stats);
+			trace_end("signature check", signature_start);
+			uint64_t timestamp = obs_get_video_frame_time();
+			uint32_t num_events =
+				ssbu_match_update(&autovod->match, screen, timestamp, match_events);
+
+			for (uint32_t i = 0; i < num_events; i++) {
+				publish_match_event(autovod, &match_events[i]);
+			}
+
+			// the stage only shows once the load-in splash has cleared
+			if (autovod->stage_attempts && screen == SSBU_SCREEN_NONE &&
+			    timestamp - autovod->match.last_loadin >= SSBU_STAGE_DELAY_NS) {
+				uint64_t detect_start = trace_begin();
+				detect_stage(autovod, &tmp_frame, timestamp);
+				trace_end("stage detect", detect_start);
+			}
 
-				memcpy(frame->rgba_data, data, linesize * autovod->height);
-				autovod->capture_frame = frame;
+			bool can_capture = autovod->capture_active ? !autovod->capture_expired
+								   : capture_cooldown;
+
+			if (screen == SSBU_SCREEN_LOADIN && can_capture) {
+				// cheap enough to keep every load-in frame, the worker picks
+				// the best one whenever it gets to run
+				uint64_t push_start = trace_begin();
+				ssbu_burst_push(autovod->burst, &tmp_frame, timestamp, true,
+						&plan->detector);
+				trace_end("burst push", push_start);
+			}
+
+			if (screen == SSBU_SCREEN_LOADIN && can_capture && !autovod->capture_pending) {
+				if (!autovod->capture_active) {
+					autovod->capture_active = true;
+					autovod->capture_timestamp = timestamp;
+					autovod->burst_cpu_ns = 0;
+					autovod->burst_lagged_frames = obs_get_lagged_frames();
+					autovod->burst_skipped_frames =
+						video_output_get_skipped_frames(obs_get_video());
+					ssbu_vote_reset(&autovod->vote);
+				}
+				autovod->capture_pending = true;
+				autovod->capture_pending_frame = timestamp;
 				autovod->seconds_since_last_capture = 0;
+				trace_flow_start("capture", timestamp);
+				pthread_cond_broadcast(&autovod->cv);
+			} else if (screen != SSBU_SCREEN_LOADIN && autovod->capture_active &&
+				   !autovod->capture_pending && autovod->vote.frames) {
+				// the load-in screen is gone, settle with the frames we have
+				autovod->capture_expired = true;
 				pthread_cond_broadcast(&autovod->cv);
 			}
 			autovod->seconds_since_last_detect = 0;
@@ -323,6 +1318,9 @@ static void autovod_on_render(void *data, gs_effect_t *unused_effect)
 		while (gs_effect_loop(effect, "Draw"))
 			gs_draw_sprite(tex, 0, autovod->width, autovod->height);
 	}
+
+	rcu_read_unlock(&autovod->plan, PLAN_READER_RENDER);
+	trace_end("render", render_start);
 }
 
 struct obs_source_info autovod_def = {
@@ -346,7 +1344,29 @@ struct obs_source_info autovod_def = {
 
 bool obs_module_load(void)
 {
-	ocr_init();
+	char *portrait_index_path = obs_module_file(SSBU_PORTRAIT_INDEX_FILE);
+	ssbu_init(portrait_index_path);
+	bfree(portrait_index_path);
+
+	char *stage_table_path = obs_module_file(SSBU_STAGE_TABLE_FILE);
+	ssbu_stage_init(stage_table_path);
+	bfree(stage_table_path);
+
+	char *audio_cue_path = obs_module_file(AUDIO_CUE_TABLE_FILE);
+	audio_cues = audio_cue_table_load(audio_cue_path);
+	bfree(audio_cue_path);
+
+	char *config_dir = obs_module_config_path("");
+	char *log_path = obs_module_config_path(EVENT_LOG_FILE);
+	char *socket_path = obs_module_config_path(EVENT_SOCKET_FILE);
+	if (config_dir) {
+		os_mkdirs(config_dir);
+		events = event_stream_create(log_path, socket_path);
+	}
+	bfree(config_dir);
+	bfree(log_path);
+	bfree(socket_path);
+
 	obs_register_source(&autovod_def);
 	obs_log(LOG_INFO, "plugin loaded successfully (version %s)", PLUGIN_VERSION);
 	return true;
@@ -354,6 +1374,12 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
-	ocr_destroy();
+	event_stream_destroy(events);
+	events = NULL;
+	audio_cue_table_destroy(audio_cues);
+	audio_cues = NULL;
+	ssbu_stage_destroy();
+	ssbu_destroy();
+	trace_destroy();
 	obs_log(LOG_INFO, "plugin unloaded");
 }
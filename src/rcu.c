@@ -0,0 +1,111 @@
+#include <string.h>
+#include <obs-module.h>
+#include <plugin-support.h>
+#include "rcu.h"
+
+void rcu_cell_init(struct rcu_cell *cell, void *initial, rcu_free_t free)
+{
+	memset(cell, 0, sizeof(*cell));
+	pthread_mutex_init(&cell->write_mutex, NULL);
+	cell->free = free;
+	cell->slots[0] = initial;
+}
+
+void rcu_cell_free(struct rcu_cell *cell)
+{
+	for (uint32_t i = 0; i < RCU_SLOTS; i++) {
+		if (cell->slots[i])
+			cell->free(cell->slots[i]);
+	}
+	pthread_mutex_destroy(&cell->write_mutex);
+}
+
+const void *rcu_read_lock(struct rcu_cell *cell, uint32_t reader)
+{
+	long slot = os_atomic_load_long(&cell->current);
+
+	// a writer that switched slots before seeing the announcement may
+	// already be freeing the old one, so check it is still current
+	while (true) {
+		os_atomic_set_long(&cell->readers[reader], slot + 1);
+
+		long current = os_atomic_load_long(&cell->current);
+		if (current == slot)
+			return cell->slots[slot];
+		slot = current;
+	}
+}
+
+void rcu_read_unlock(struct rcu_cell *cell, uint32_t reader)
+{
+	os_atomic_set_long(&cell->readers[reader], 0);
+}
+
+static bool in_use(struct rcu_cell *cell, long slot)
+{
+	for (uint32_t i = 0; i < RCU_MAX_READERS; i++) {
+		if (os_atomic_load_long(&cell->readers[i]) == slot + 1)
+			return true;
+	}
+	return false;
+}
+
+static void reclaim(struct rcu_cell *cell)
+{
+	for (long i = 0; i < RCU_SLOTS; i++) {
+		if (cell->retired[i] && !in_use(cell, i)) {
+			cell->free(cell->slots[i]);
+			cell->slots[i] = NULL;
+			cell->retired[i] = false;
+		}
+	}
+}
+
+static long free_slot(struct rcu_cell *cell)
+{
+	for (long i = 0; i < RCU_SLOTS; i++) {
+		if (!cell->slots[i])
+			return i;
+	}
+	return -1;
+}
+
+// call with write_mutex held
+static void publish_locked(struct rcu_cell *cell, void *data)
+{
+	// at most one retired object per reader survives this
+	reclaim(cell);
+	long slot = free_slot(cell);
+
+	long old = cell->current;
+	cell->slots[slot] = data;
+	os_atomic_set_long(&cell->current, slot);
+	os_atomic_inc_long(&cell->generation);
+	cell->retired[old] = true;
+	reclaim(cell);
+}
+
+void rcu_publish(struct rcu_cell *cell, void *data)
+{
+	pthread_mutex_lock(&cell->write_mutex);
+	publish_locked(cell, data);
+	pthread_mutex_unlock(&cell->write_mutex);
+}
+
+long rcu_generation(struct rcu_cell *cell)
+{
+	return os_atomic_load_long(&cell->generation);
+}
+
+bool rcu_publish_if_current(struct rcu_cell *cell, void *data, long generation)
+{
+	pthread_mutex_lock(&cell->write_mutex);
+	bool current = cell->generation == generation;
+	if (current)
+		publish_locked(cell, data);
+	pthread_mutex_unlock(&cell->write_mutex);
+
+	if (!current)
+		cell->free(data);
+	return current;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/threading.h>
+
+#define RCU_MAX_READERS 3
+// every reader pins at most one old object, so a writer always finds a
+// free slot for the new one next to the current object
+#define RCU_SLOTS (RCU_MAX_READERS + 2)
+
+typedef void (*rcu_free_t)(void *data);
+
+/*
+ * Holds one immutable object that a fixed set of reader threads can use
+ * without locking while writers replace it. Each reader announces the
+ * slot it is reading, a replaced object is freed once no reader announces
+ * its slot any more. Writers never wait for readers.
+ *
+ * The current object is published as a slot index since libobs only has
+ * atomics for longs and bools.
+ */
+struct rcu_cell {
+	pthread_mutex_t write_mutex;
+	rcu_free_t free;
+	void *slots[RCU_SLOTS];
+	bool retired[RCU_SLOTS];
+	volatile long current;
+	volatile long generation; // bumped by every publish
+	volatile long readers[RCU_MAX_READERS]; // slot + 1, 0 = not reading
+};
+
+void rcu_cell_init(struct rcu_cell *cell, void *initial, rcu_free_t free);
+void rcu_cell_free(struct rcu_cell *cell);
+
+// each reader index must be used by one thread at a time, no nesting
+const void *rcu_read_lock(struct rcu_cell *cell, uint32_t reader);
+void rcu_read_unlock(struct rcu_cell *cell, uint32_t reader);
+
+// takes ownership of data, only blocks other writers
+void rcu_publish(struct rcu_cell *cell, void *data);
+
+/*
+ * For writers that build the object from state another writer may replace
+ * meanwhile: read the generation before reading that state, then publish
+ * only if nothing was published since. Frees data and returns false
+ * otherwise, the caller rebuilds from the newer state and tries again.
+ */
+long rcu_generation(struct rcu_cell *cell);
+bool rcu_publish_if_current(struct rcu_cell *cell, void *data, long generation);
+
+#ifdef __cplusplus
+}
+#endif
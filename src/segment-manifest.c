@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include <obs-module.h>
+#include <util/threading.h>
+#include <plugin-support.h>
+#include "segment-manifest.h"
+
+#define SEGMENT_CHARACTER_MAX 32
+#define SEGMENT_STAGE_MAX 32
+
+struct segment {
+	uint64_t start;
+	uint64_t end;
+	char characters[NUM_SMASH_CHARACTERS][SEGMENT_CHARACTER_MAX];
+	char stage[SEGMENT_STAGE_MAX];
+};
+
+struct segment_manifest {
+	pthread_mutex_t mutex;
+	uint64_t base_timestamp;
+	uint64_t base_uncertainty;
+	struct segment *segments;
+	size_t num_segments;
+	size_t capacity;
+};
+
+struct segment_manifest *segment_manifest_create(uint64_t base_timestamp,
+						 uint64_t base_uncertainty)
+{
+	struct segment_manifest *manifest = bzalloc(sizeof(struct segment_manifest));
+
+	pthread_mutex_init(&manifest->mutex, NULL);
+	manifest->base_timestamp = base_timestamp;
+	manifest->base_uncertainty = base_uncertainty;
+	return manifest;
+}
+
+void segment_manifest_destroy(struct segment_manifest *manifest)
+{
+	if (!manifest) {
+		return;
+	}
+
+	pthread_mutex_destroy(&manifest->mutex);
+	bfree(manifest->segments);
+	bfree(manifest);
+}
+
+static struct segment *last_open_segment(struct segment_manifest *manifest)
+{
+	if (!manifest->num_segments) {
+		return NULL;
+	}
+
+	struct segment *segment = &manifest->segments[manifest->num_segments - 1];
+	return segment->end ? NULL : segment;
+}
+
+void segment_manifest_add_event(struct segment_manifest *manifest,
+				const struct ssbu_match_event *event)
+{
+	if (!manifest) {
+		return;
+	}
+
+	pthread_mutex_lock(&manifest->mutex);
+
+	if (event->type == SSBU_EVENT_GAME_START) {
+		if (manifest->num_segments == manifest->capacity) {
+			manifest->capacity = manifest->capacity ? manifest->capacity * 2 : 16;
+			manifest->segments = brealloc(manifest->segments,
+						      manifest->capacity * sizeof(struct segment));
+		}
+
+		struct segment *segment = &manifest->segments[manifest->num_segments++];
+		memset(segment, 0, sizeof(*segment));
+		segment->start = event->start;
+	} else {
+		struct segment *segment = last_open_segment(manifest);
+		if (segment && segment->start == event->start) {
+			segment->end = event->end;
+		}
+	}
+
+	pthread_mutex_unlock(&manifest->mutex);
+}
+
+static struct segment *segment_at(struct segment_manifest *manifest, uint64_t timestamp)
+{
+	for (size_t i = manifest->num_segments; i > 0; i--) {
+		struct segment *segment = &manifest->segments[i - 1];
+
+		if (segment->start <= timestamp && (!segment->end || timestamp <= segment->end)) {
+			return segment;
+		}
+	}
+
+	return NULL;
+}
+
+void segment_manifest_set_characters(struct segment_manifest *manifest, uint64_t timestamp,
+				     const struct ssbu_result *result)
+{
+	if (!manifest) {
+		return;
+	}
+
+	pthread_mutex_lock(&manifest->mutex);
+
+	// results arrive after the start event, attach them to the game they were captured in
+	struct segment *segment = segment_at(manifest, timestamp);
+	if (segment) {
+		for (int j = 0; j < NUM_SMASH_CHARACTERS; j++) {
+			const char *name = result->players[j].character;
+			if (name && !segment->characters[j][0]) {
+				snprintf(segment->characters[j], SEGMENT_CHARACTER_MAX, "%s", name);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&manifest->mutex);
+}
+
+void segment_manifest_set_stage(struct segment_manifest *manifest, uint64_t timestamp,
+				const char *stage)
+{
+	if (!manifest || !stage) {
+		return;
+	}
+
+	pthread_mutex_lock(&manifest->mutex);
+
+	struct segment *segment = segment_at(manifest, timestamp);
+	if (segment && !segment->stage[0]) {
+		snprintf(segment->stage, SEGMENT_STAGE_MAX, "%s", stage);
+	}
+
+	pthread_mutex_unlock(&manifest->mutex);
+}
+
+static double relative_seconds(struct segment_manifest *manifest, uint64_t timestamp)
+{
+	if (timestamp < manifest->base_timestamp) {
+		return 0.0;
+	}
+
+	return (double)(timestamp - manifest->base_timestamp) / 1000000000.0;
+}
+
+bool segment_manifest_save(struct segment_manifest *manifest, const char *path,
+			   const char *recording_path)
+{
+	bool success;
+
+	if (!manifest || !path) {
+		return false;
+	}
+
+	obs_data_t *data = obs_data_create();
+	obs_data_array_t *segments = obs_data_array_create();
+
+	obs_data_set_string(data, "recording", recording_path ? recording_path : "");
+	obs_data_set_double(data, "base_uncertainty", (double)manifest->base_uncertainty / 1e9);
+
+	pthread_mutex_lock(&manifest->mutex);
+	for (size_t i = 0; i < manifest->num_segments; i++) {
+		struct segment *segment = &manifest->segments[i];
+
+		// a game still running when the recording stopped never got its end
+		if (!segment->end) {
+			continue;
+		}
+
+		obs_data_t *item = obs_data_create();
+		obs_data_set_double(item, "start", relative_seconds(manifest, segment->start));
+		obs_data_set_double(item, "end", relative_seconds(manifest, segment->end));
+		obs_data_set_string(item, "player1", segment->characters[0]);
+		obs_data_set_string(item, "player2", segment->characters[1]);
+		obs_data_set_string(item, "stage", segment->stage);
+		obs_data_array_push_back(segments, item);
+		obs_data_release(item);
+	}
+	pthread_mutex_unlock(&manifest->mutex);
+
+	obs_data_set_array(data, "segments", segments);
+	success = obs_data_save_json_safe(data, path, "tmp", "bak");
+
+	obs_data_array_release(segments);
+	obs_data_release(data);
+
+	if (success) {
+		obs_log(LOG_INFO, "Wrote segment manifest %s", path);
+	} else {
+		obs_log(LOG_WARNING, "Failed to write segment manifest %s", path);
+	}
+
+	return success;
+}
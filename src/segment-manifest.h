@@ -0,0 +1,50 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "game-detect/smash-ultimate.h"
+
+/*
+ * Collects the games seen during one recording and writes them as a JSON
+ * manifest for autovod-split:
+ *
+ *   {
+ *     "recording": "/path/to/recording.mkv",
+ *     "base_uncertainty": 0.052,
+ *     "segments": [
+ *       { "start": 12.345, "end": 301.002, "player1": "MARIO", "player2": "LINK",
+ *       "stage": "battlefield" },
+ *       ...
+ *     ]
+ *   }
+ *
+ * start/end are seconds from the base timestamp. The plugin only learns
+ * when a recording starts from frontend events, not from the first
+ * packet, so the base is the time of the "recording started" event and the
+ * first frame of the file lies within base_uncertainty seconds of it.
+ * Without a recording, the base is the time the filter was created.
+ */
+
+#define SEGMENT_MANIFEST_SUFFIX ".autovod.json"
+
+struct segment_manifest;
+
+struct segment_manifest *segment_manifest_create(uint64_t base_timestamp,
+						 uint64_t base_uncertainty);
+void segment_manifest_destroy(struct segment_manifest *manifest);
+void segment_manifest_add_event(struct segment_manifest *manifest,
+				const struct ssbu_match_event *event);
+void segment_manifest_set_characters(struct segment_manifest *manifest, uint64_t timestamp,
+				     const struct ssbu_result *result);
+void segment_manifest_set_stage(struct segment_manifest *manifest, uint64_t timestamp,
+				const char *stage);
+bool segment_manifest_save(struct segment_manifest *manifest, const char *path,
+			   const char *recording_path);
+
+#ifdef __cplusplus
+}
+#endif
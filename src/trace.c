@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <plugin-support.h>
+#include "trace.h"
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+#define TRACE_THREAD_NAME_MAX 32
+
+enum trace_phase {
+	TRACE_SPAN,
+	TRACE_FLOW_START,
+	TRACE_FLOW_END,
+};
+
+struct trace_event {
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+	uint64_t frame; // flow id for flow events
+	enum trace_phase phase;
+};
+
+// written by its thread only, trace_write reads up to the published count
+struct trace_buffer {
+	struct trace_buffer *next;
+	bool in_use;
+	uint32_t tid;
+	char name[TRACE_THREAD_NAME_MAX];
+	uint64_t frame;
+	volatile long written;
+	struct trace_event events[TRACE_BUFFER_EVENTS];
+};
+
+static volatile bool enabled = false;
+static pthread_mutex_t buffers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer *buffers = NULL;
+static uint32_t next_tid = 1;
+// bumped by trace_destroy, rings a thread still points to from before are gone
+static volatile long generation = 1;
+
+static TRACE_THREAD_LOCAL struct trace_buffer *local_buffer = NULL;
+static TRACE_THREAD_LOCAL long local_generation = 0;
+static TRACE_THREAD_LOCAL char local_name[TRACE_THREAD_NAME_MAX];
+
+void trace_set_enabled(bool enable)
+{
+	if (os_atomic_load_bool(&enabled) != enable) {
+		obs_log(LOG_INFO, "Pipeline tracing %s", enable ? "enabled" : "disabled");
+	}
+	os_atomic_set_bool(&enabled, enable);
+}
+
+void trace_destroy(void)
+{
+	os_atomic_set_bool(&enabled, false);
+
+	pthread_mutex_lock(&buffers_mutex);
+	os_atomic_inc_long(&generation);
+	while (buffers) {
+		struct trace_buffer *next = buffers->next;
+		bfree(buffers);
+		buffers = next;
+	}
+	pthread_mutex_unlock(&buffers_mutex);
+}
+
+// rings are only allocated for threads that record while tracing is on,
+// a ring left by an exited thread is reused before allocating another
+static struct trace_buffer *get_buffer(void)
+{
+	long current = os_atomic_load_long(&generation);
+
+	if (local_buffer && local_generation == current) {
+		return local_buffer;
+	}
+
+	struct trace_buffer *buffer = NULL;
+
+	pthread_mutex_lock(&buffers_mutex);
+	for (struct trace_buffer *unused = buffers; unused; unused = unused->next) {
+		if (!unused->in_use) {
+			buffer = unused;
+			break;
+		}
+	}
+
+	if (buffer) {
+		os_atomic_set_long(&buffer->written, 0);
+		buffer->frame = 0;
+	} else {
+		buffer = bzalloc(sizeof(struct trace_buffer));
+		buffer->next = buffers;
+		buffers = buffer;
+	}
+
+	buffer->in_use = true;
+	buffer->tid = next_tid++;
+	snprintf(buffer->name, sizeof(buffer->name), "%s", local_name);
+	pthread_mutex_unlock(&buffers_mutex);
+
+	local_buffer = buffer;
+	local_generation = current;
+	return buffer;
+}
+
+void trace_thread_exit(void)
+{
+	pthread_mutex_lock(&buffers_mutex);
+	// after a trace_destroy the ring is already freed
+	if (local_buffer && local_generation == os_atomic_load_long(&generation)) {
+		local_buffer->in_use = false;
+	}
+	pthread_mutex_unlock(&buffers_mutex);
+
+	local_buffer = NULL;
+	local_name[0] = '\0';
+}
+
+void trace_thread_name(const char *name)
+{
+	snprintf(local_name, sizeof(local_name), "%s", name);
+	if (local_buffer) {
+		snprintf(local_buffer->name, sizeof(local_buffer->name), "%s", name);
+	}
+}
+
+void trace_frame(uint64_t frame)
+{
+	if (os_atomic_load_bool(&enabled)) {
+		get_buffer()->frame = frame;
+	}
+}
+
+uint64_t trace_begin(void)
+{
+	return os_atomic_load_bool(&enabled) ? os_gettime_ns() : 0;
+}
+
+static void record(const char *name, enum trace_phase phase, uint64_t start, uint64_t end,
+		   uint64_t frame)
+{
+	struct trace_buffer *buffer = get_buffer();
+	long n = buffer->written;
+	struct trace_event *event = &buffer->events[n % TRACE_BUFFER_EVENTS];
+
+	event->name = name;
+	event->phase = phase;
+	event->start = start;
+	event->end = end;
+	event->frame = frame;
+	os_atomic_set_long(&buffer->written, n + 1);
+}
+
+void trace_end(const char *name, uint64_t start)
+{
+	if (!start || !os_atomic_load_bool(&enabled)) {
+		return;
+	}
+
+	record(name, TRACE_SPAN, start, os_gettime_ns(), get_buffer()->frame);
+}
+
+void trace_flow_start(const char *name, uint64_t id)
+{
+	if (os_atomic_load_bool(&enabled)) {
+		uint64_t now = os_gettime_ns();
+		record(name, TRACE_FLOW_START, now, now, id);
+	}
+}
+
+void trace_flow_end(const char *name, uint64_t id)
+{
+	if (os_atomic_load_bool(&enabled)) {
+		uint64_t now = os_gettime_ns();
+		record(name, TRACE_FLOW_END, now, now, id);
+	}
+}
+
+static void write_event(FILE *fp, uint32_t tid, struct trace_event *event)
+{
+	double ts = (double)event->start / 1000.0;
+
+	switch (event->phase) {
+	case TRACE_SPAN:
+		fprintf(fp,
+			",\n{\"name\":\"%s\",\"cat\":\"autovod\",\"ph\":\"X\",\"ts\":%.3f,"
+			"\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%llu}}",
+			event->name, ts, (double)(event->end - event->start) / 1000.0, tid,
+			(unsigned long long)event->frame);
+		break;
+	case TRACE_FLOW_START:
+	case TRACE_FLOW_END:
+		// flow ends bind to the span that encloses them
+		fprintf(fp,
+			",\n{\"name\":\"%s\",\"cat\":\"autovod\",\"ph\":\"%s\",\"id\":\"0x%llx\","
+			"\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+			event->name, event->phase == TRACE_FLOW_START ? "s" : "f\",\"bp\":\"e",
+			(unsigned long long)event->frame, ts, tid);
+		break;
+	}
+}
+
+bool trace_write(const char *path)
+{
+	struct trace_event *events = bmalloc(sizeof(struct trace_event) * TRACE_BUFFER_EVENTS);
+	uint64_t total = 0;
+
+	FILE *fp = os_fopen(path, "wb");
+	if (!fp) {
+		obs_log(LOG_WARNING, "Failed to open trace file '%s'", path);
+		bfree(events);
+		return false;
+	}
+
+	fprintf(fp, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+		    "\"args\":{\"name\":\"autovod\"}}");
+
+	pthread_mutex_lock(&buffers_mutex);
+	for (struct trace_buffer *buffer = buffers; buffer; buffer = buffer->next) {
+		// an exited thread's ring keeps its spans until another thread takes it
+		long end = os_atomic_load_long(&buffer->written);
+		long begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+
+		for (long i = begin; i < end; i++) {
+			events[i - begin] = buffer->events[i % TRACE_BUFFER_EVENTS];
+		}
+
+		// the owner kept recording while we copied, drop what it overwrote
+		long now = os_atomic_load_long(&buffer->written);
+		long valid = now - TRACE_BUFFER_EVENTS + 1;
+		if (valid < begin)
+			valid = begin;
+
+		fprintf(fp,
+			",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			"\"args\":{\"name\":\"%s\"}}",
+			buffer->tid, buffer->name[0] ? buffer->name : "unnamed");
+
+		for (long i = valid; i < end; i++) {
+			write_event(fp, buffer->tid, &events[i - begin]);
+			total++;
+		}
+	}
+	pthread_mutex_unlock(&buffers_mutex);
+
+	fprintf(fp, "\n]}\n");
+	bool success = fclose(fp) == 0;
+	bfree(events);
+
+	obs_log(LOG_INFO, "Wrote %llu trace events to '%s'", (unsigned long long)total, path);
+	return success;
+}
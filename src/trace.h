@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TRACE_BUFFER_EVENTS 16384
+#define TRACE_FILE_PREFIX "autovod-trace-"
+
+/*
+ * Span tracing across the render thread, the detection worker and the
+ * recognizers. Every thread records into its own ring, so recording never
+ * takes a lock; the oldest spans are overwritten once a ring is full.
+ * trace_write dumps all rings as a Chrome trace (chrome://tracing or
+ * ui.perfetto.dev).
+ *
+ * Spans are tagged with the thread's current frame, the video timestamp
+ * of the frame being worked on. Recording is off by default and then
+ * costs one atomic load per span.
+ *
+ * Threads that exit call trace_thread_exit so the next thread reuses
+ * their ring. trace_destroy frees every ring; a thread that records
+ * afterwards gets a new one instead of the freed pointer.
+ */
+
+void trace_set_enabled(bool enabled);
+void trace_destroy(void);
+
+// labels the calling thread in the trace
+void trace_thread_name(const char *name);
+// hands the calling thread's ring back, its spans stay until it is reused
+void trace_thread_exit(void);
+void trace_frame(uint64_t frame);
+
+// returns 0 when recording is off, trace_end then does nothing
+uint64_t trace_begin(void);
+// name must be a string literal, only the pointer is stored
+void trace_end(const char *name, uint64_t start);
+
+// arrows between threads, e.g. a frame handed from the render thread to the worker
+void trace_flow_start(const char *name, uint64_t id);
+void trace_flow_end(const char *name, uint64_t id);
+
+bool trace_write(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
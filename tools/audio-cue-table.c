@@ -0,0 +1,262 @@
+/*
+ * Builds the audio cue table loaded by the plugin (ssbu-audio-cues.bin).
+ *
+ * usage: autovod-audio-cues <list.tsv> <out.bin>
+ *
+ * Each line of the list is "<type>\t<name>\t<wav>", where type is one of
+ * loadin, go or game and the wav is a 16 bit PCM or 32 bit float recording
+ * trimmed to the cue. Anything past AUDIO_CUE_MAX_FRAMES hops is dropped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio-cue.h"
+
+#define MAX_LINE 1024
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+
+struct wav {
+	uint32_t sample_rate;
+	uint32_t channels;
+	uint32_t frames;
+	float **planes;
+};
+
+static uint32_t le32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *buf)
+{
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static void wav_free(struct wav *wav)
+{
+	for (uint32_t c = 0; wav->planes && c < wav->channels; c++) {
+		free(wav->planes[c]);
+	}
+	free(wav->planes);
+}
+
+static bool read_wav(const char *filename, struct wav *wav)
+{
+	uint8_t header[12];
+	uint8_t chunk[8];
+	uint8_t fmt[16];
+	uint16_t format = 0;
+	uint16_t bits = 0;
+	bool have_fmt = false;
+	bool success = false;
+
+	memset(wav, 0, sizeof(*wav));
+
+	FILE *fp = fopen(filename, "rb");
+	if (!fp) {
+		return false;
+	}
+
+	if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+	    memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+		goto done;
+	}
+
+	while (fread(chunk, 1, sizeof(chunk), fp) == sizeof(chunk)) {
+		uint32_t size = le32(chunk + 4);
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && size >= sizeof(fmt)) {
+			if (fread(fmt, 1, sizeof(fmt), fp) != sizeof(fmt)) {
+				goto done;
+			}
+			format = le16(fmt);
+			wav->channels = le16(fmt + 2);
+			wav->sample_rate = le32(fmt + 4);
+			bits = le16(fmt + 14);
+			have_fmt = true;
+			fseek(fp, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+
+		} else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+			bool pcm16 = format == WAV_FORMAT_PCM && bits == 16;
+			bool float32 = format == WAV_FORMAT_FLOAT && bits == 32;
+			uint32_t sample_size = bits / 8;
+
+			if ((!pcm16 && !float32) || !wav->channels) {
+				fprintf(stderr, "%s: only 16 bit PCM and 32 bit float are supported\n",
+					filename);
+				goto done;
+			}
+
+			wav->frames = size / (sample_size * wav->channels);
+			wav->planes = calloc(wav->channels, sizeof(float *));
+			for (uint32_t c = 0; c < wav->channels; c++) {
+				wav->planes[c] = calloc(wav->frames ? wav->frames : 1, sizeof(float));
+			}
+
+			for (uint32_t i = 0; i < wav->frames; i++) {
+				for (uint32_t c = 0; c < wav->channels; c++) {
+					uint8_t sample[4];
+
+					if (fread(sample, 1, sample_size, fp) != sample_size) {
+						goto done;
+					}
+
+					if (pcm16) {
+						wav->planes[c][i] = (float)(int16_t)le16(sample) / 32768.0f;
+					} else {
+						uint32_t raw = le32(sample);
+						memcpy(&wav->planes[c][i], &raw, sizeof(float));
+					}
+				}
+			}
+
+			success = true;
+			break;
+
+		} else {
+			fseek(fp, (long)(size + (size & 1)), SEEK_CUR);
+		}
+	}
+
+done:
+	fclose(fp);
+	if (!success) {
+		wav_free(wav);
+	}
+	return success;
+}
+
+static void write_u32(FILE *fp, uint32_t val)
+{
+	uint8_t buf[4] = {(uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16),
+			  (uint8_t)(val >> 24)};
+	fwrite(buf, 1, sizeof(buf), fp);
+}
+
+static void write_u16(FILE *fp, uint16_t val)
+{
+	uint8_t buf[2] = {(uint8_t)val, (uint8_t)(val >> 8)};
+	fwrite(buf, 1, sizeof(buf), fp);
+}
+
+int main(int argc, char **argv)
+{
+	static int8_t bands[AUDIO_CUE_MAX_CUES][AUDIO_CUE_MAX_FRAMES][AUDIO_CUE_BANDS];
+	char *names[AUDIO_CUE_MAX_CUES];
+	enum audio_cue_type types[AUDIO_CUE_MAX_CUES];
+	uint32_t num_frames[AUDIO_CUE_MAX_CUES];
+	uint32_t num_cues = 0;
+	char line[MAX_LINE];
+	int ret = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <list.tsv> <out.bin>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *list = fopen(argv[1], "r");
+	if (!list) {
+		fprintf(stderr, "failed to open %s\n", argv[1]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), list)) {
+		struct wav wav;
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *type = strtok(line, "\t");
+		char *name = strtok(NULL, "\t");
+		char *path = strtok(NULL, "\t");
+
+		if (!type || !name || !path || type[0] == '#') {
+			continue;
+		}
+
+		if (num_cues >= AUDIO_CUE_MAX_CUES || strlen(name) > 255) {
+			fprintf(stderr, "too many cues or too long name at '%s'\n", name);
+			goto done;
+		}
+
+		types[num_cues] = audio_cue_type_from_name(type);
+		if (types[num_cues] == AUDIO_CUE_NONE) {
+			fprintf(stderr, "unknown cue type '%s'\n", type);
+			goto done;
+		}
+
+		if (!read_wav(path, &wav)) {
+			fprintf(stderr, "failed to read %s\n", path);
+			goto done;
+		}
+
+		// feed hop sized chunks so every analyzed frame can be collected
+		struct audio_cue_detector *detector =
+			audio_cue_detector_create(NULL, wav.sample_rate);
+		const float *planes[8] = {0};
+		uint32_t channels = wav.channels < 8 ? wav.channels : 8;
+		uint32_t frames = 0;
+
+		for (uint32_t i = 0; i < wav.frames && frames < AUDIO_CUE_MAX_FRAMES;
+		     i += AUDIO_CUE_HOP) {
+			uint32_t count = wav.frames - i < AUDIO_CUE_HOP ? wav.frames - i
+								      : AUDIO_CUE_HOP;
+			uint64_t before = audio_cue_detector_frames(detector);
+
+			for (uint32_t c = 0; c < channels; c++) {
+				planes[c] = wav.planes[c] + i;
+			}
+
+			audio_cue_detector_process(detector, planes, channels, count);
+			if (audio_cue_detector_frames(detector) != before) {
+				audio_cue_detector_bands(detector, bands[num_cues][frames++]);
+			}
+		}
+
+		audio_cue_detector_destroy(detector);
+		wav_free(&wav);
+
+		if (!frames) {
+			fprintf(stderr, "%s is shorter than one analysis window\n", path);
+			goto done;
+		}
+
+		names[num_cues] = strdup(name);
+		num_frames[num_cues] = frames;
+		printf("%s %s: %u frames\n", type, name, frames);
+		num_cues++;
+	}
+
+	FILE *out = fopen(argv[2], "wb");
+	if (!out) {
+		fprintf(stderr, "failed to open %s\n", argv[2]);
+		goto done;
+	}
+
+	fwrite(AUDIO_CUE_TABLE_MAGIC, 1, 4, out);
+	write_u32(out, AUDIO_CUE_TABLE_VERSION);
+	write_u32(out, num_cues);
+
+	for (uint32_t i = 0; i < num_cues; i++) {
+		uint8_t len = (uint8_t)strlen(names[i]);
+		uint8_t type = (uint8_t)types[i];
+
+		fwrite(&len, 1, 1, out);
+		fwrite(names[i], 1, len, out);
+		fwrite(&type, 1, 1, out);
+		write_u16(out, (uint16_t)num_frames[i]);
+		fwrite(bands[i], 1, num_frames[i] * AUDIO_CUE_BANDS, out);
+	}
+
+	fclose(out);
+	printf("wrote %u cues to %s\n", num_cues, argv[2]);
+	ret = 0;
+
+done:
+	fclose(list);
+	for (uint32_t i = 0; i < num_cues; i++) {
+		free(names[i]);
+	}
+	return ret;
+}
@@ -0,0 +1,462 @@
+/*
+ * Runs the detection pipeline over an existing recording and writes the
+ * segment manifest the plugin would have produced (<input>.autovod.json).
+ *
+ * usage: autovod-scan [-j ranges] [-t decode threads] [-i interval] [-p portraits.bin]
+ *                     [-s stages.bin] [--fast] <recording>
+ *
+ * The file is split into equal time ranges that are decoded in parallel,
+ * each with its own demuxer and decoder. Only sampled frames are converted
+ * to RGBA and checked, screen observations are merged in order afterwards so
+ * games spanning range boundaries are paired correctly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include "img-utils.h"
+#include "ocr.h"
+#include "segment-manifest.h"
+#include "trace.h"
+#include "game-detect/smash-ultimate.h"
+#include "game-detect/smash-ultimate-stage.h"
+
+#define MAX_RANGES 256
+#define DEFAULT_INTERVAL 0.05
+#define CAPTURE_INTERVAL_NS 10000000000ULL
+#define OCR_MAX_FRAMES 5
+#define OCR_CONFIDENCE 0.8f
+#define OCR_AGREEMENT 2
+#define STAGE_MAX_ATTEMPTS 20
+#define DETECT_WIDTH 1920
+#define DETECT_HEIGHT 1080
+
+struct observation {
+	uint64_t timestamp;
+	enum ssbu_screen screen;
+};
+
+struct detection {
+	uint64_t timestamp;
+	struct ssbu_result result;
+};
+
+struct stage_detection {
+	uint64_t timestamp;
+	const char *stage;
+};
+
+struct scan_range {
+	const char *path;
+	double start;
+	double end;
+	double interval;
+	int decode_threads;
+	bool fast;
+
+	struct observation *observations;
+	size_t num_observations;
+	struct detection *detections;
+	size_t num_detections;
+	struct stage_detection *stages;
+	size_t num_stages;
+	uint64_t frames_decoded;
+	uint64_t frames_checked;
+	struct ssbu_scan_stats scan_stats;
+	bool success;
+};
+
+// the OCR engine is a single global instance, serialize access to it
+static pthread_mutex_t detect_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void add_observation(struct scan_range *range, uint64_t timestamp, enum ssbu_screen screen)
+{
+	range->observations = realloc(range->observations, sizeof(struct observation) *
+								   (range->num_observations + 1));
+	range->observations[range->num_observations].timestamp = timestamp;
+	range->observations[range->num_observations].screen = screen;
+	range->num_observations++;
+}
+
+static void add_detection(struct scan_range *range, uint64_t timestamp, struct ssbu_vote *vote)
+{
+	range->detections =
+		realloc(range->detections, sizeof(struct detection) * (range->num_detections + 1));
+
+	struct detection *detection = &range->detections[range->num_detections++];
+	detection->timestamp = timestamp;
+	ssbu_vote_result(vote, &detection->result);
+}
+
+static void add_stage(struct scan_range *range, uint64_t timestamp, const char *stage)
+{
+	range->stages =
+		realloc(range->stages, sizeof(struct stage_detection) * (range->num_stages + 1));
+	range->stages[range->num_stages].timestamp = timestamp;
+	range->stages[range->num_stages].stage = stage;
+	range->num_stages++;
+}
+
+static bool vote_frame(struct ssbu_vote *vote, struct frame_data *frame)
+{
+	struct ssbu_result result;
+
+	pthread_mutex_lock(&detect_mutex);
+	ssbu_detect(frame, NULL, &result);
+	pthread_mutex_unlock(&detect_mutex);
+
+	return ssbu_vote_add(vote, &result, OCR_CONFIDENCE, OCR_AGREEMENT) ||
+	       vote->frames >= OCR_MAX_FRAMES;
+}
+
+static void *scan_range_thread(void *data)
+{
+	struct scan_range *range = data;
+	AVFormatContext *fmt = NULL;
+	AVCodecContext *codec = NULL;
+	AVPacket *pkt = NULL;
+	AVFrame *av_frame = NULL;
+	struct SwsContext *sws = NULL;
+	struct frame_data frame = {0};
+	double next_sample = range->start;
+	uint64_t last_capture = 0;
+	bool have_capture = false;
+	bool voting = false;
+	struct ssbu_vote vote;
+	uint64_t last_loadin = 0;
+	uint32_t stage_attempts = 0;
+	int video_idx;
+
+	ssbu_scan_stats_init(&range->scan_stats);
+
+	if (avformat_open_input(&fmt, range->path, NULL, NULL) < 0 ||
+	    avformat_find_stream_info(fmt, NULL) < 0) {
+		goto done;
+	}
+
+	const AVCodec *decoder = NULL;
+	video_idx = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+	if (video_idx < 0 || !decoder) {
+		goto done;
+	}
+
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		if ((int)i != video_idx)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	AVStream *stream = fmt->streams[video_idx];
+	codec = avcodec_alloc_context3(decoder);
+	avcodec_parameters_to_context(codec, stream->codecpar);
+	codec->thread_count = range->decode_threads;
+	codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	codec->pkt_timebase = stream->time_base;
+	if (range->fast) {
+		// deblocking barely changes the few pixels we look at
+		codec->skip_loop_filter = AVDISCARD_ALL;
+	}
+
+	if (avcodec_open2(codec, decoder, NULL) < 0) {
+		goto done;
+	}
+
+	int64_t stream_start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+	if (range->start > 0.0) {
+		int64_t seek_ts = stream_start + av_rescale_q((int64_t)(range->start * AV_TIME_BASE),
+							      AV_TIME_BASE_Q, stream->time_base);
+		av_seek_frame(fmt, video_idx, seek_ts, AVSEEK_FLAG_BACKWARD);
+	}
+
+	frame_data_init(&frame, DETECT_WIDTH, DETECT_HEIGHT);
+	pkt = av_packet_alloc();
+	av_frame = av_frame_alloc();
+	bool finished = false;
+	bool draining = false;
+
+	while (!finished) {
+		if (!draining) {
+			if (av_read_frame(fmt, pkt) < 0) {
+				draining = true;
+				avcodec_send_packet(codec, NULL);
+			} else if (pkt->stream_index != video_idx) {
+				av_packet_unref(pkt);
+				continue;
+			} else {
+				avcodec_send_packet(codec, pkt);
+				av_packet_unref(pkt);
+			}
+		}
+
+		while (avcodec_receive_frame(codec, av_frame) == 0) {
+			int64_t pts = av_frame->best_effort_timestamp;
+			double t = (double)(pts - stream_start) * av_q2d(stream->time_base);
+
+			range->frames_decoded++;
+
+			if (t >= range->end) {
+				finished = true;
+				break;
+			}
+
+			if (t < next_sample) {
+				continue;
+			}
+			next_sample = t + range->interval;
+
+			uint8_t *dst[1] = {frame.rgba_data};
+			int dst_linesize[1] = {(int)frame.width * 4};
+			sws = sws_getCachedContext(sws, av_frame->width, av_frame->height,
+						   av_frame->format, DETECT_WIDTH, DETECT_HEIGHT,
+						   AV_PIX_FMT_RGBA,
+						   range->fast ? SWS_POINT : SWS_FAST_BILINEAR, NULL,
+						   NULL, NULL);
+			sws_scale(sws, (const uint8_t *const *)av_frame->data, av_frame->linesize, 0,
+				  av_frame->height, dst, dst_linesize);
+			range->frames_checked++;
+
+			uint64_t timestamp = (uint64_t)(t * 1e9);
+			enum ssbu_screen screen = ssbu_detect_screen(&frame, NULL, &range->scan_stats);
+
+			if (screen != SSBU_SCREEN_NONE) {
+				add_observation(range, timestamp, screen);
+			}
+
+			// the stage table is read-only, no need to take detect_mutex
+			if (screen == SSBU_SCREEN_LOADIN) {
+				last_loadin = timestamp;
+				stage_attempts = ssbu_stage_loaded() ? STAGE_MAX_ATTEMPTS : 0;
+			} else if (screen == SSBU_SCREEN_NONE && stage_attempts &&
+				   timestamp - last_loadin >= SSBU_STAGE_DELAY_NS) {
+				const char *stage = ssbu_detect_stage(&frame, NULL);
+				stage_attempts = stage ? 0 : stage_attempts - 1;
+				if (stage) {
+					add_stage(range, timestamp, stage);
+				}
+			} else if (screen != SSBU_SCREEN_NONE) {
+				stage_attempts = 0;
+			}
+
+			// same burst voting as the plugin, read frames of one load-in
+			// screen until the characters are settled
+			if (screen == SSBU_SCREEN_LOADIN && !voting &&
+			    (!have_capture || timestamp - last_capture >= CAPTURE_INTERVAL_NS)) {
+				ssbu_vote_reset(&vote);
+				voting = true;
+				last_capture = timestamp;
+				have_capture = true;
+			}
+
+			if (voting && (screen != SSBU_SCREEN_LOADIN || vote_frame(&vote, &frame))) {
+				if (vote.frames) {
+					add_detection(range, last_capture, &vote);
+				}
+				voting = false;
+			}
+		}
+
+		if (draining) {
+			break;
+		}
+	}
+
+	if (voting && vote.frames) {
+		add_detection(range, last_capture, &vote);
+	}
+
+	range->success = true;
+
+done:
+	sws_freeContext(sws);
+	av_frame_free(&av_frame);
+	av_packet_free(&pkt);
+	avcodec_free_context(&codec);
+	avformat_close_input(&fmt);
+	if (frame.rgba_data)
+		frame_data_destroy(&frame);
+	trace_thread_exit();
+	return NULL;
+}
+
+static double probe_duration(const char *path)
+{
+	AVFormatContext *fmt = NULL;
+	double duration = 0.0;
+
+	if (avformat_open_input(&fmt, path, NULL, NULL) < 0) {
+		return 0.0;
+	}
+
+	if (avformat_find_stream_info(fmt, NULL) >= 0 && fmt->duration != AV_NOPTS_VALUE) {
+		duration = (double)fmt->duration / AV_TIME_BASE;
+	}
+
+	avformat_close_input(&fmt);
+	return duration;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	const char *portrait_index = NULL;
+	const char *stage_table = NULL;
+	int num_ranges = os_get_logical_cores();
+	int decode_threads = 1;
+	double interval = DEFAULT_INTERVAL;
+	bool fast = false;
+	struct scan_range ranges[MAX_RANGES];
+	pthread_t threads[MAX_RANGES];
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			num_ranges = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			decode_threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			interval = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			portrait_index = argv[++i];
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			stage_table = argv[++i];
+		} else if (strcmp(argv[i], "--fast") == 0) {
+			fast = true;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (!path) {
+		fprintf(stderr,
+			"usage: %s [-j ranges] [-t decode threads] [-i interval] "
+			"[-p portraits.bin] [-s stages.bin] [--fast] <recording>\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (num_ranges < 1)
+		num_ranges = 1;
+	if (num_ranges > MAX_RANGES)
+		num_ranges = MAX_RANGES;
+	if (decode_threads < 1)
+		decode_threads = 1;
+
+	double duration = probe_duration(path);
+	if (duration <= 0.0) {
+		fprintf(stderr, "failed to read duration of %s\n", path);
+		return 1;
+	}
+
+	ocr_init();
+	ssbu_init(portrait_index);
+	ssbu_stage_init(stage_table);
+
+	uint64_t start_ns = os_gettime_ns();
+
+	for (int i = 0; i < num_ranges; i++) {
+		memset(&ranges[i], 0, sizeof(ranges[i]));
+		ranges[i].path = path;
+		ranges[i].start = duration * i / num_ranges;
+		ranges[i].end = i == num_ranges - 1 ? duration + 1.0 : duration * (i + 1) / num_ranges;
+		ranges[i].interval = interval;
+		ranges[i].decode_threads = decode_threads;
+		ranges[i].fast = fast;
+	}
+
+	int started = 0;
+	for (; started < num_ranges; started++) {
+		if (pthread_create(&threads[started], NULL, scan_range_thread, &ranges[started]) !=
+		    0) {
+			fprintf(stderr, "failed to start scan thread %d of %d\n", started + 1,
+				num_ranges);
+			break;
+		}
+	}
+
+	// ranges without a thread are scanned here instead of being left out
+	for (int i = started; i < num_ranges; i++) {
+		scan_range_thread(&ranges[i]);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	double seconds = (double)(os_gettime_ns() - start_ns) / 1e9;
+
+	// replay the observations in file order through the same match tracker
+	// the plugin uses, then attach the OCR results to their games
+	struct segment_manifest *manifest = segment_manifest_create(0, 0);
+	struct ssbu_match match = {0};
+	uint64_t frames_decoded = 0;
+	uint64_t frames_checked = 0;
+	uint64_t pixels_read = 0;
+	uint32_t games = 0;
+	int failed = 0;
+
+	for (int i = 0; i < num_ranges; i++) {
+		struct scan_range *range = &ranges[i];
+
+		failed += range->success ? 0 : 1;
+		frames_decoded += range->frames_decoded;
+		frames_checked += range->frames_checked;
+		pixels_read += range->scan_stats.pixels_read;
+
+		for (size_t j = 0; j < range->num_observations; j++) {
+			struct ssbu_match_event events[SSBU_MAX_MATCH_EVENTS];
+			uint32_t num_events = ssbu_match_update(&match, range->observations[j].screen,
+								range->observations[j].timestamp,
+								events);
+
+			for (uint32_t k = 0; k < num_events; k++) {
+				segment_manifest_add_event(manifest, &events[k]);
+				games += events[k].type == SSBU_EVENT_GAME_END ? 1 : 0;
+			}
+		}
+	}
+
+	// the end of the file closes a game whose end screen was never seen
+	struct ssbu_match_event last_end;
+	if (ssbu_match_end(&match, (uint64_t)(duration * 1e9), &last_end)) {
+		segment_manifest_add_event(manifest, &last_end);
+		games++;
+	}
+
+	for (int i = 0; i < num_ranges; i++) {
+		for (size_t j = 0; j < ranges[i].num_detections; j++) {
+			segment_manifest_set_characters(manifest, ranges[i].detections[j].timestamp,
+							&ranges[i].detections[j].result);
+		}
+		for (size_t j = 0; j < ranges[i].num_stages; j++) {
+			segment_manifest_set_stage(manifest, ranges[i].stages[j].timestamp,
+						   ranges[i].stages[j].stage);
+		}
+		free(ranges[i].observations);
+		free(ranges[i].detections);
+		free(ranges[i].stages);
+	}
+
+	char *manifest_path = bmalloc(strlen(path) + sizeof(SEGMENT_MANIFEST_SUFFIX));
+	strcpy(manifest_path, path);
+	strcat(manifest_path, SEGMENT_MANIFEST_SUFFIX);
+	segment_manifest_save(manifest, manifest_path, path);
+
+	printf("%u games, %d/%d ranges failed\n", games, failed, num_ranges);
+	printf("%.1fs of video in %.1fs (%.1fx realtime), %.0f frames/s decoded, "
+	       "%.0f frames/s checked\n",
+	       duration, seconds, duration / seconds, (double)frames_decoded / seconds,
+	       (double)frames_checked / seconds);
+	printf("%.1f signature pixels read per checked frame\n",
+	       frames_checked ? (double)pixels_read / (double)frames_checked : 0.0);
+	printf("manifest: %s\n", manifest_path);
+
+	bfree(manifest_path);
+	segment_manifest_destroy(manifest);
+	ssbu_stage_destroy();
+	ssbu_destroy();
+	ocr_destroy();
+	return failed ? 1 : 0;
+}
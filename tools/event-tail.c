@@ -0,0 +1,127 @@
+/*
+ * Follows the plugin's detection events.
+ *
+ * usage: autovod-events <events.jsonl>     print the log and follow appends
+ *        autovod-events --socket <path>    subscribe to live events
+ *
+ * Each event is printed as the JSON line the plugin wrote, so the output can
+ * be piped straight into overlay or scoreboard tooling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define POLL_INTERVAL_US 2000
+#define READ_BUFFER_SIZE 65536
+
+static int follow_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	char buf[READ_BUFFER_SIZE];
+	ssize_t len;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "invalid socket path %s\n", path);
+		return 1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "failed to create socket: %s\n", strerror(errno));
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "failed to connect to %s: %s\n", path, strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		fwrite(buf, 1, (size_t)len, stdout);
+		fflush(stdout);
+	}
+
+	close(fd);
+	return 0;
+}
+
+static int follow_log(const char *path)
+{
+	char buf[READ_BUFFER_SIZE];
+	struct stat st, open_st;
+	off_t offset = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	while (1) {
+		ssize_t len = read(fd, buf, sizeof(buf));
+
+		if (len > 0) {
+			fwrite(buf, 1, (size_t)len, stdout);
+			offset += len;
+			continue;
+		}
+
+		if (len < 0) {
+			fprintf(stderr, "read failed: %s\n", strerror(errno));
+			break;
+		}
+
+		fflush(stdout);
+
+		if (stat(path, &st) != 0 || fstat(fd, &open_st) != 0) {
+			usleep(POLL_INTERVAL_US);
+			continue;
+		}
+
+		if (st.st_dev != open_st.st_dev || st.st_ino != open_st.st_ino) {
+			// rotated, everything left in the old file has been read above
+			int new_fd = open(path, O_RDONLY);
+			if (new_fd >= 0) {
+				close(fd);
+				fd = new_fd;
+				offset = 0;
+				continue;
+			}
+		} else if (st.st_size < offset) {
+			// truncated in place
+			lseek(fd, 0, SEEK_SET);
+			offset = 0;
+		}
+
+		usleep(POLL_INTERVAL_US);
+	}
+
+	close(fd);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 3 && strcmp(argv[1], "--socket") == 0) {
+		return follow_socket(argv[2]);
+	}
+
+	if (argc == 2) {
+		return follow_log(argv[1]);
+	}
+
+	fprintf(stderr, "usage: %s <events.jsonl> | --socket <path>\n", argv[0]);
+	return 1;
+}
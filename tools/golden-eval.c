@@ -0,0 +1,515 @@
+/*
+ * Runs the detection pipeline over a labeled corpus of frames and reports
+ * screen precision/recall, character and stage accuracy and per-stage
+ * latency. With a baseline it fails when a metric regresses beyond the
+ * baseline's tolerances, so threshold and OCR tuning can be checked before
+ * it reaches a stream. It also fails when the corpus has no frames, the
+ * baseline lacks a metric or a character has no labeled load-in frame,
+ * since a gate over missing data passes anything.
+ *
+ * usage: autovod-eval [-p portraits.bin] [-s stages.bin] [-d detector.json]
+ *                     [-b baseline.json] [-w] <corpus.tsv>
+ *
+ * Each line of the corpus is "<png>\t<screen>[\t<player1>\t<player2>[\t<stage>]]",
+ * where screen is one of loadin, game_end, results or none. Characters are
+ * only checked on load-in frames and stages on frames that name one, "-"
+ * leaves a field unlabeled. Relative png paths are resolved against the
+ * corpus file's directory. autovod-golden extracts such frames from a
+ * recording and its manifest.
+ *
+ * -d evaluates the signatures of a detector file instead of the built-ins,
+ * which is how the GAME! and results signatures get tuned before they are
+ * enabled. -w writes the current results to the baseline instead of
+ * comparing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include <obs.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include "img-utils.h"
+#include "ocr.h"
+#include "game-detect/smash-ultimate.h"
+#include "game-detect/smash-ultimate-burst.h"
+#include "game-detect/smash-ultimate-stage.h"
+
+#define MAX_LINE 1024
+#define DEFAULT_ACCURACY_TOLERANCE 0.01
+#define DEFAULT_LATENCY_TOLERANCE 0.25
+
+enum eval_stage {
+	EVAL_SCREEN,
+	EVAL_CHARACTERS,
+	EVAL_STAGE,
+	EVAL_NUM_STAGES,
+};
+
+static const char *eval_stage_names[EVAL_NUM_STAGES] = {"screen", "characters", "stage"};
+static const char *screen_names[] = {"none", "loadin", "game_end", "results"};
+#define NUM_SCREENS (sizeof(screen_names) / sizeof(screen_names[0]))
+
+struct latencies {
+	uint64_t *samples;
+	size_t count;
+};
+
+struct eval_results {
+	uint32_t frames;
+	// confusion counts, [expected][detected]
+	uint32_t screens[NUM_SCREENS][NUM_SCREENS];
+	uint32_t players;
+	uint32_t players_correct;
+	uint32_t stages;
+	uint32_t stages_correct;
+	struct latencies latency[EVAL_NUM_STAGES];
+	bool *characters_seen;
+};
+
+enum metric_direction {
+	HIGHER_IS_BETTER,
+	LOWER_IS_BETTER,
+};
+
+struct metric {
+	char name[64];
+	double value;
+	enum metric_direction direction;
+};
+
+static bool read_png(const char *filename, struct frame_data *frame)
+{
+	png_image image;
+
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&image, filename)) {
+		return false;
+	}
+
+	image.format = PNG_FORMAT_RGBA;
+	frame_data_init(frame, image.width, image.height);
+
+	if (!png_image_finish_read(&image, NULL, frame->rgba_data, 0, NULL)) {
+		frame_data_destroy(frame);
+		return false;
+	}
+
+	return true;
+}
+
+static int parse_screen(const char *name)
+{
+	for (size_t i = 0; i < NUM_SCREENS; i++) {
+		if (strcmp(screen_names[i], name) == 0)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+static bool labeled(const char *field)
+{
+	return field && *field && strcmp(field, "-") != 0;
+}
+
+static void add_latency(struct latencies *latency, uint64_t ns)
+{
+	latency->samples = realloc(latency->samples, sizeof(uint64_t) * (latency->count + 1));
+	latency->samples[latency->count++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+static double percentile_ms(struct latencies *latency, double p)
+{
+	if (!latency->count) {
+		return 0.0;
+	}
+
+	qsort(latency->samples, latency->count, sizeof(uint64_t), compare_u64);
+	size_t idx = (size_t)(p * (double)(latency->count - 1) + 0.5);
+	return (double)latency->samples[idx] / 1e6;
+}
+
+static struct ssbu_config detector;
+static struct ssbu_burst *burst;
+static uint64_t frame_number;
+
+// the same route a load-in takes in the filter, through the run length
+// encoded burst buffer and OCR on the decoded name boxes
+static void detect_characters(struct frame_data *frame, struct ssbu_result *result)
+{
+	struct ssbu_burst_frame best;
+	uint64_t timestamp = ++frame_number;
+
+	ssbu_burst_push(burst, frame, timestamp, true, &detector);
+	if (!ssbu_burst_take_best(burst, timestamp, &best)) {
+		memset(result, 0, sizeof(*result));
+		return;
+	}
+
+	ssbu_detect_boxes(best.name_boxes, best.has_portraits ? best.portraits : NULL, &detector,
+			  result);
+	ssbu_burst_frame_free(&best);
+}
+
+static void eval_frame(struct eval_results *results, struct frame_data *frame, int screen,
+		       char **players, const char *stage)
+{
+	struct ssbu_scan_stats stats;
+	uint64_t start;
+
+	// fresh stats per frame, the adaptive area order must not depend on corpus order
+	ssbu_scan_stats_init(&stats);
+
+	start = os_gettime_ns();
+	enum ssbu_screen detected = ssbu_detect_screen(frame, &detector, &stats);
+	add_latency(&results->latency[EVAL_SCREEN], os_gettime_ns() - start);
+	results->screens[screen][detected]++;
+
+	if (screen == SSBU_SCREEN_LOADIN && (labeled(players[0]) || labeled(players[1]))) {
+		struct ssbu_result result;
+
+		start = os_gettime_ns();
+		detect_characters(frame, &result);
+		add_latency(&results->latency[EVAL_CHARACTERS], os_gettime_ns() - start);
+
+		for (int i = 0; i < NUM_SMASH_CHARACTERS; i++) {
+			if (!labeled(players[i])) {
+				continue;
+			}
+
+			const char *character = result.players[i].character;
+			bool correct = character && strcmp(character, players[i]) == 0;
+
+			results->players++;
+			results->players_correct += correct ? 1 : 0;
+			if (!correct) {
+				printf("  player %d: expected %s, got %s\n", i + 1, players[i],
+				       character ? character : "nothing");
+			}
+
+			for (uint32_t j = 0; j < ssbu_num_characters(); j++) {
+				if (strcmp(ssbu_character_name(j), players[i]) == 0)
+					results->characters_seen[j] = true;
+			}
+		}
+	}
+
+	if (labeled(stage)) {
+		start = os_gettime_ns();
+		const char *detected_stage = ssbu_detect_stage(frame, NULL);
+		add_latency(&results->latency[EVAL_STAGE], os_gettime_ns() - start);
+
+		bool correct = detected_stage && strcmp(detected_stage, stage) == 0;
+		results->stages++;
+		results->stages_correct += correct ? 1 : 0;
+		if (!correct) {
+			printf("  stage: expected %s, got %s\n", stage,
+			       detected_stage ? detected_stage : "nothing");
+		}
+	}
+}
+
+static bool eval_corpus(const char *corpus_path, struct eval_results *results)
+{
+	struct dstr dir = {0};
+	struct dstr png_path = {0};
+	char line[MAX_LINE];
+	bool success = false;
+
+	FILE *corpus = fopen(corpus_path, "r");
+	if (!corpus) {
+		fprintf(stderr, "failed to open %s\n", corpus_path);
+		return false;
+	}
+
+	const char *slash = strrchr(corpus_path, '/');
+	if (slash) {
+		dstr_ncopy(&dir, corpus_path, slash - corpus_path + 1);
+	}
+
+	while (fgets(line, sizeof(line), corpus)) {
+		struct frame_data frame;
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *path = strtok(line, "\t");
+		char *screen_name = strtok(NULL, "\t");
+		char *players[NUM_SMASH_CHARACTERS];
+		players[0] = strtok(NULL, "\t");
+		players[1] = strtok(NULL, "\t");
+		char *stage = strtok(NULL, "\t");
+
+		if (!path || !screen_name || path[0] == '#') {
+			continue;
+		}
+
+		int screen = parse_screen(screen_name);
+		if (screen < 0) {
+			fprintf(stderr, "unknown screen '%s' for %s\n", screen_name, path);
+			goto done;
+		}
+
+		if (path[0] == '/') {
+			dstr_copy(&png_path, path);
+		} else {
+			dstr_printf(&png_path, "%s%s", dir.array ? dir.array : "", path);
+		}
+
+		if (!read_png(png_path.array, &frame)) {
+			fprintf(stderr, "failed to read %s\n", png_path.array);
+			goto done;
+		}
+
+		if (frame.width != 1920 || frame.height != 1080) {
+			fprintf(stderr, "%s is %ux%u, detection expects 1920x1080\n", png_path.array,
+				frame.width, frame.height);
+			frame_data_destroy(&frame);
+			goto done;
+		}
+
+		printf("%s\n", path);
+		eval_frame(results, &frame, screen, players, stage);
+		results->frames++;
+		frame_data_destroy(&frame);
+	}
+
+	success = true;
+
+done:
+	fclose(corpus);
+	dstr_free(&dir);
+	dstr_free(&png_path);
+	return success;
+}
+
+static void add_metric(struct metric *metrics, size_t *num_metrics, const char *name, double value,
+		       enum metric_direction direction)
+{
+	struct metric *metric = &metrics[(*num_metrics)++];
+
+	snprintf(metric->name, sizeof(metric->name), "%s", name);
+	metric->value = value;
+	metric->direction = direction;
+}
+
+static size_t collect_metrics(struct eval_results *results, struct metric *metrics)
+{
+	size_t num_metrics = 0;
+	char name[64];
+
+	// every screen except "none" is a detection class
+	for (size_t s = 1; s < NUM_SCREENS; s++) {
+		uint32_t true_pos = results->screens[s][s];
+		uint32_t detected = 0;
+		uint32_t expected = 0;
+
+		for (size_t i = 0; i < NUM_SCREENS; i++) {
+			detected += results->screens[i][s];
+			expected += results->screens[s][i];
+		}
+
+		snprintf(name, sizeof(name), "%s_precision", screen_names[s]);
+		add_metric(metrics, &num_metrics, name,
+			   detected ? (double)true_pos / detected : 1.0, HIGHER_IS_BETTER);
+		snprintf(name, sizeof(name), "%s_recall", screen_names[s]);
+		add_metric(metrics, &num_metrics, name,
+			   expected ? (double)true_pos / expected : 1.0, HIGHER_IS_BETTER);
+	}
+
+	add_metric(metrics, &num_metrics, "character_accuracy",
+		   results->players ? (double)results->players_correct / results->players : 1.0,
+		   HIGHER_IS_BETTER);
+	add_metric(metrics, &num_metrics, "stage_accuracy",
+		   results->stages ? (double)results->stages_correct / results->stages : 1.0,
+		   HIGHER_IS_BETTER);
+
+	for (int i = 0; i < EVAL_NUM_STAGES; i++) {
+		snprintf(name, sizeof(name), "%s_p50_ms", eval_stage_names[i]);
+		add_metric(metrics, &num_metrics, name, percentile_ms(&results->latency[i], 0.50),
+			   LOWER_IS_BETTER);
+		snprintf(name, sizeof(name), "%s_p99_ms", eval_stage_names[i]);
+		add_metric(metrics, &num_metrics, name, percentile_ms(&results->latency[i], 0.99),
+			   LOWER_IS_BETTER);
+	}
+
+	return num_metrics;
+}
+
+static bool write_baseline(const char *path, struct metric *metrics, size_t num_metrics)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *values = obs_data_create();
+
+	for (size_t i = 0; i < num_metrics; i++) {
+		obs_data_set_double(values, metrics[i].name, metrics[i].value);
+	}
+
+	obs_data_set_obj(data, "metrics", values);
+	obs_data_set_double(data, "accuracy_tolerance", DEFAULT_ACCURACY_TOLERANCE);
+	obs_data_set_double(data, "latency_tolerance", DEFAULT_LATENCY_TOLERANCE);
+	bool success = obs_data_save_json_safe(data, path, "tmp", "bak");
+
+	obs_data_release(values);
+	obs_data_release(data);
+	return success;
+}
+
+static uint32_t compare_baseline(obs_data_t *baseline, struct metric *metrics, size_t num_metrics)
+{
+	obs_data_t *values = obs_data_get_obj(baseline, "metrics");
+	uint32_t regressions = 0;
+
+	// absolute for ratios, relative for latencies since those depend on the machine
+	obs_data_set_default_double(baseline, "accuracy_tolerance", DEFAULT_ACCURACY_TOLERANCE);
+	obs_data_set_default_double(baseline, "latency_tolerance", DEFAULT_LATENCY_TOLERANCE);
+	double accuracy_tolerance = obs_data_get_double(baseline, "accuracy_tolerance");
+	double latency_tolerance = obs_data_get_double(baseline, "latency_tolerance");
+
+	for (size_t i = 0; i < num_metrics; i++) {
+		struct metric *metric = &metrics[i];
+
+		if (!values || !obs_data_has_user_value(values, metric->name)) {
+			printf("MISSING %s: %.4f (not in the baseline, rewrite it with -w)\n",
+			       metric->name, metric->value);
+			regressions++;
+			continue;
+		}
+
+		double expected = obs_data_get_double(values, metric->name);
+		bool regressed = metric->direction == HIGHER_IS_BETTER
+					 ? metric->value < expected - accuracy_tolerance
+					 : metric->value > expected * (1.0 + latency_tolerance);
+
+		if (regressed) {
+			printf("REGRESSION %s: %.4f (baseline %.4f)\n", metric->name, metric->value,
+			       expected);
+			regressions++;
+		}
+	}
+
+	obs_data_release(values);
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	const char *portrait_index = NULL;
+	const char *stage_table = NULL;
+	const char *detector_path = NULL;
+	const char *baseline_path = NULL;
+	const char *corpus_path = NULL;
+	bool update_baseline = false;
+	struct eval_results results = {0};
+	struct metric metrics[32];
+	int ret = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			portrait_index = argv[++i];
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			stage_table = argv[++i];
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			detector_path = argv[++i];
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (strcmp(argv[i], "-w") == 0) {
+			update_baseline = true;
+		} else {
+			corpus_path = argv[i];
+		}
+	}
+
+	if (!corpus_path || (update_baseline && !baseline_path)) {
+		fprintf(stderr,
+			"usage: %s [-p portraits.bin] [-s stages.bin] [-d detector.json] "
+			"[-b baseline.json] [-w] <corpus.tsv>\n",
+			argv[0]);
+		return 1;
+	}
+
+	ssbu_config_init(&detector);
+	if (detector_path && !ssbu_config_load(&detector, detector_path)) {
+		fprintf(stderr, "failed to load %s\n", detector_path);
+		return 1;
+	}
+
+	ocr_init();
+	ssbu_init(portrait_index);
+	ssbu_stage_init(stage_table);
+	burst = ssbu_burst_create(SSBU_BURST_BUDGET);
+	results.characters_seen = calloc(ssbu_num_characters(), sizeof(bool));
+
+	if (!eval_corpus(corpus_path, &results)) {
+		goto done;
+	}
+
+	if (!results.frames) {
+		fprintf(stderr, "%s has no frames, extract some with autovod-golden\n",
+			corpus_path);
+		goto done;
+	}
+
+	size_t num_metrics = collect_metrics(&results, metrics);
+
+	printf("\n");
+	for (size_t i = 0; i < num_metrics; i++) {
+		printf("%-24s %.4f\n", metrics[i].name, metrics[i].value);
+	}
+
+	uint32_t missing = 0;
+	for (uint32_t i = 0; i < ssbu_num_characters(); i++) {
+		if (!results.characters_seen[i]) {
+			printf("no labeled load-in frame for %s\n", ssbu_character_name(i));
+			missing++;
+		}
+	}
+	printf("%u/%u characters covered\n", ssbu_num_characters() - missing,
+	       ssbu_num_characters());
+
+	if (update_baseline) {
+		if (!write_baseline(baseline_path, metrics, num_metrics)) {
+			fprintf(stderr, "failed to write %s\n", baseline_path);
+			goto done;
+		}
+		printf("wrote baseline %s\n", baseline_path);
+		ret = 0;
+	} else if (baseline_path) {
+		obs_data_t *baseline = obs_data_create_from_json_file(baseline_path);
+		if (!baseline) {
+			fprintf(stderr, "failed to read %s\n", baseline_path);
+			goto done;
+		}
+
+		uint32_t regressions = compare_baseline(baseline, metrics, num_metrics);
+		obs_data_release(baseline);
+
+		printf("%u regression(s) against %s\n", regressions, baseline_path);
+		if (missing) {
+			printf("FAILED %u character(s) without a labeled load-in frame\n", missing);
+		}
+		ret = regressions || missing ? 1 : 0;
+	} else {
+		ret = 0;
+	}
+
+done:
+	for (int i = 0; i < EVAL_NUM_STAGES; i++) {
+		free(results.latency[i].samples);
+	}
+	free(results.characters_seen);
+	ssbu_burst_destroy(burst);
+	ssbu_stage_destroy();
+	ssbu_destroy();
+	ocr_destroy();
+	return ret;
+}
@@ -0,0 +1,265 @@
+/*
+ * Pulls labeled golden frames for autovod-eval out of a recording and its
+ * segment manifest. For every game it writes the load-in frame labeled with
+ * the game's players and a gameplay frame labeled with its stage, as PNGs in
+ * the output directory, and appends their lines to <outdir>/corpus.tsv.
+ *
+ * usage: autovod-golden [-o outdir] [-r recording] <manifest.json>
+ *
+ * The labels are whatever the manifest says, which is what the detector
+ * saw. Check every frame against its line and fix or drop the wrong ones
+ * before committing them, a corpus that agrees with a wrong detection
+ * gates nothing. Then write the baseline with autovod-eval -w.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <obs.h>
+#include <util/dstr.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include "img-utils.h"
+#include "game-detect/smash-ultimate-stage.h"
+
+#define FRAME_WIDTH 1920
+#define FRAME_HEIGHT 1080
+// the names are fully faded in about a second into the load-in screen
+#define LOADIN_OFFSET 1.0
+// well past the load-in splash, before the stage gets crowded
+#define GAMEPLAY_OFFSET ((double)SSBU_STAGE_DELAY_NS / 1e9 + 2.0)
+
+struct decoder {
+	AVFormatContext *fmt;
+	AVCodecContext *codec;
+	AVPacket *pkt;
+	AVFrame *frame;
+	struct SwsContext *sws;
+	int video_idx;
+	int64_t stream_start;
+};
+
+static bool decoder_open(struct decoder *dec, const char *path)
+{
+	const AVCodec *codec = NULL;
+
+	memset(dec, 0, sizeof(*dec));
+
+	if (avformat_open_input(&dec->fmt, path, NULL, NULL) < 0 ||
+	    avformat_find_stream_info(dec->fmt, NULL) < 0) {
+		return false;
+	}
+
+	dec->video_idx = av_find_best_stream(dec->fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+	if (dec->video_idx < 0 || !codec) {
+		return false;
+	}
+
+	AVStream *stream = dec->fmt->streams[dec->video_idx];
+	dec->stream_start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+	dec->codec = avcodec_alloc_context3(codec);
+	avcodec_parameters_to_context(dec->codec, stream->codecpar);
+	dec->codec->pkt_timebase = stream->time_base;
+
+	if (avcodec_open2(dec->codec, codec, NULL) < 0) {
+		return false;
+	}
+
+	dec->pkt = av_packet_alloc();
+	dec->frame = av_frame_alloc();
+	return true;
+}
+
+static void decoder_close(struct decoder *dec)
+{
+	sws_freeContext(dec->sws);
+	av_frame_free(&dec->frame);
+	av_packet_free(&dec->pkt);
+	avcodec_free_context(&dec->codec);
+	avformat_close_input(&dec->fmt);
+}
+
+// decodes the first frame at or after t seconds into out, scaled to 1920x1080
+static bool decoder_read_at(struct decoder *dec, double t, struct frame_data *out)
+{
+	AVStream *stream = dec->fmt->streams[dec->video_idx];
+	int64_t seek_ts = dec->stream_start + av_rescale_q((int64_t)(t * AV_TIME_BASE),
+							   AV_TIME_BASE_Q, stream->time_base);
+
+	if (av_seek_frame(dec->fmt, dec->video_idx, seek_ts, AVSEEK_FLAG_BACKWARD) < 0) {
+		return false;
+	}
+	avcodec_flush_buffers(dec->codec);
+
+	bool draining = false;
+	while (true) {
+		if (!draining) {
+			if (av_read_frame(dec->fmt, dec->pkt) < 0) {
+				draining = true;
+				avcodec_send_packet(dec->codec, NULL);
+			} else if (dec->pkt->stream_index != dec->video_idx) {
+				av_packet_unref(dec->pkt);
+				continue;
+			} else {
+				avcodec_send_packet(dec->codec, dec->pkt);
+				av_packet_unref(dec->pkt);
+			}
+		}
+
+		while (avcodec_receive_frame(dec->codec, dec->frame) == 0) {
+			int64_t pts = dec->frame->best_effort_timestamp;
+			double frame_t =
+				(double)(pts - dec->stream_start) * av_q2d(stream->time_base);
+
+			if (frame_t < t) {
+				continue;
+			}
+
+			uint8_t *dst[1] = {out->rgba_data};
+			int dst_linesize[1] = {(int)out->width * 4};
+			dec->sws = sws_getCachedContext(dec->sws, dec->frame->width,
+							dec->frame->height, dec->frame->format,
+							FRAME_WIDTH, FRAME_HEIGHT, AV_PIX_FMT_RGBA,
+							SWS_BILINEAR, NULL, NULL, NULL);
+			sws_scale(dec->sws, (const uint8_t *const *)dec->frame->data,
+				  dec->frame->linesize, 0, dec->frame->height, dst, dst_linesize);
+			return true;
+		}
+
+		if (draining) {
+			return false;
+		}
+	}
+}
+
+static const char *label(obs_data_t *segment, const char *name)
+{
+	const char *value = obs_data_get_string(segment, name);
+	return *value ? value : "-";
+}
+
+static bool write_frame(struct decoder *dec, double t, struct frame_data *frame,
+			const char *out_dir, const char *file, FILE *corpus, const char *labels)
+{
+	struct dstr path = {0};
+
+	if (!decoder_read_at(dec, t, frame)) {
+		fprintf(stderr, "no frame at %.3fs\n", t);
+		return false;
+	}
+
+	dstr_printf(&path, "%s/%s", out_dir, file);
+	img_write_png(frame, path.array);
+	dstr_free(&path);
+
+	fprintf(corpus, "%s\t%s\n", file, labels);
+	printf("%s\t%s\n", file, labels);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out_dir = ".";
+	const char *recording = NULL;
+	const char *manifest_path = NULL;
+	struct decoder dec = {0};
+	struct frame_data frame = {0};
+	struct dstr corpus_path = {0};
+	struct dstr file = {0};
+	struct dstr labels = {0};
+	FILE *corpus = NULL;
+	int ret = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out_dir = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			recording = argv[++i];
+		} else {
+			manifest_path = argv[i];
+		}
+	}
+
+	if (!manifest_path) {
+		fprintf(stderr, "usage: %s [-o outdir] [-r recording] <manifest.json>\n", argv[0]);
+		return 1;
+	}
+
+	obs_data_t *manifest = obs_data_create_from_json_file(manifest_path);
+	if (!manifest) {
+		fprintf(stderr, "failed to read %s\n", manifest_path);
+		return 1;
+	}
+
+	if (!recording) {
+		recording = obs_data_get_string(manifest, "recording");
+	}
+
+	if (!recording || !*recording) {
+		fprintf(stderr, "manifest has no recording, pass one with -r\n");
+		goto done;
+	}
+
+	if (!decoder_open(&dec, recording)) {
+		fprintf(stderr, "failed to open %s\n", recording);
+		goto done;
+	}
+
+	dstr_printf(&corpus_path, "%s/corpus.tsv", out_dir);
+	corpus = fopen(corpus_path.array, "a");
+	if (!corpus) {
+		fprintf(stderr, "failed to open %s\n", corpus_path.array);
+		goto done;
+	}
+
+	const char *name = strrchr(recording, '/');
+	name = name ? name + 1 : recording;
+	frame_data_init(&frame, FRAME_WIDTH, FRAME_HEIGHT);
+
+	obs_data_array_t *segments = obs_data_get_array(manifest, "segments");
+	size_t num_segments = obs_data_array_count(segments);
+	size_t written = 0;
+
+	for (size_t i = 0; i < num_segments; i++) {
+		obs_data_t *segment = obs_data_array_item(segments, i);
+		double start = obs_data_get_double(segment, "start");
+		double end = obs_data_get_double(segment, "end");
+
+		dstr_printf(&file, "%s-%03zu-loadin.png", name, i);
+		dstr_printf(&labels, "loadin\t%s\t%s", label(segment, "player1"),
+			    label(segment, "player2"));
+		written += write_frame(&dec, start + LOADIN_OFFSET, &frame, out_dir, file.array,
+				       corpus, labels.array)
+				   ? 1
+				   : 0;
+
+		if (start + GAMEPLAY_OFFSET < end) {
+			dstr_printf(&file, "%s-%03zu-stage.png", name, i);
+			dstr_printf(&labels, "none\t-\t-\t%s", label(segment, "stage"));
+			written += write_frame(&dec, start + GAMEPLAY_OFFSET, &frame, out_dir,
+					       file.array, corpus, labels.array)
+					   ? 1
+					   : 0;
+		}
+
+		obs_data_release(segment);
+	}
+	obs_data_array_release(segments);
+
+	printf("%zu frames from %zu games appended to %s, review their labels\n", written,
+	       num_segments, corpus_path.array);
+	ret = written ? 0 : 1;
+
+done:
+	if (corpus)
+		fclose(corpus);
+	if (frame.rgba_data)
+		frame_data_destroy(&frame);
+	decoder_close(&dec);
+	dstr_free(&corpus_path);
+	dstr_free(&file);
+	dstr_free(&labels);
+	obs_data_release(manifest);
+	return ret;
+}
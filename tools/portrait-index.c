@@ -0,0 +1,172 @@
+/*
+ * Builds the portrait hash index loaded by the plugin (ssbu-portraits.bin).
+ *
+ * usage: autovod-portrait-index <list.tsv> <out.bin>
+ *
+ * Each line of the list is "<name>\t<costume>\t<player slot>\t<loadin png>",
+ * where the png is a full load-in screen capture and the slot (0 or 1)
+ * selects which side's portrait is hashed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "img-utils.h"
+#include "phash.h"
+#include "game-detect/smash-ultimate.h"
+
+#define MAX_NAMES 256
+#define MAX_LINE 1024
+
+struct index_entry {
+	uint64_t hash;
+	uint16_t name_idx;
+	uint16_t costume;
+};
+
+static bool read_png(const char *filename, struct frame_data *frame)
+{
+	png_image image;
+
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&image, filename)) {
+		return false;
+	}
+
+	image.format = PNG_FORMAT_RGBA;
+	frame_data_init(frame, image.width, image.height);
+
+	if (!png_image_finish_read(&image, NULL, frame->rgba_data, 0, NULL)) {
+		frame_data_destroy(frame);
+		return false;
+	}
+
+	return true;
+}
+
+static void write_u16(FILE *fp, uint16_t val)
+{
+	uint8_t buf[2] = {(uint8_t)val, (uint8_t)(val >> 8)};
+	fwrite(buf, 1, sizeof(buf), fp);
+}
+
+static void write_u32(FILE *fp, uint32_t val)
+{
+	uint8_t buf[4] = {(uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16),
+			  (uint8_t)(val >> 24)};
+	fwrite(buf, 1, sizeof(buf), fp);
+}
+
+static void write_u64(FILE *fp, uint64_t val)
+{
+	write_u32(fp, (uint32_t)val);
+	write_u32(fp, (uint32_t)(val >> 32));
+}
+
+static int find_or_add_name(char **names, uint32_t *num_names, const char *name)
+{
+	for (uint32_t i = 0; i < *num_names; i++) {
+		if (strcmp(names[i], name) == 0)
+			return (int)i;
+	}
+
+	if (*num_names >= MAX_NAMES || strlen(name) > 255)
+		return -1;
+
+	names[*num_names] = strdup(name);
+	return (int)(*num_names)++;
+}
+
+int main(int argc, char **argv)
+{
+	char *names[MAX_NAMES];
+	uint32_t num_names = 0;
+	struct index_entry *entries = NULL;
+	uint32_t num_entries = 0;
+	char line[MAX_LINE];
+	int ret = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <list.tsv> <out.bin>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *list = fopen(argv[1], "r");
+	if (!list) {
+		fprintf(stderr, "failed to open %s\n", argv[1]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), list)) {
+		struct frame_data frame;
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *name = strtok(line, "\t");
+		char *costume = strtok(NULL, "\t");
+		char *slot = strtok(NULL, "\t");
+		char *path = strtok(NULL, "\t");
+
+		if (!name || !costume || !slot || !path || name[0] == '#') {
+			continue;
+		}
+
+		int name_idx = find_or_add_name(names, &num_names, name);
+		if (name_idx < 0) {
+			fprintf(stderr, "too many or too long names at '%s'\n", name);
+			goto done;
+		}
+
+		if (!read_png(path, &frame)) {
+			fprintf(stderr, "failed to read %s\n", path);
+			goto done;
+		}
+
+		entries = realloc(entries, sizeof(struct index_entry) * (num_entries + 1));
+		entries[num_entries].hash = ssbu_portrait_hash(&frame, atoi(slot) ? 1 : 0);
+		entries[num_entries].name_idx = (uint16_t)name_idx;
+		entries[num_entries].costume = (uint16_t)atoi(costume);
+		printf("%016llx %s (costume %s)\n", (unsigned long long)entries[num_entries].hash,
+		       name, costume);
+		num_entries++;
+
+		frame_data_destroy(&frame);
+	}
+
+	FILE *out = fopen(argv[2], "wb");
+	if (!out) {
+		fprintf(stderr, "failed to open %s\n", argv[2]);
+		goto done;
+	}
+
+	fwrite(PHASH_INDEX_MAGIC, 1, 4, out);
+	write_u32(out, PHASH_INDEX_VERSION);
+	write_u32(out, num_names);
+	write_u32(out, num_entries);
+
+	for (uint32_t i = 0; i < num_names; i++) {
+		uint8_t len = (uint8_t)strlen(names[i]);
+		fwrite(&len, 1, 1, out);
+		fwrite(names[i], 1, len, out);
+	}
+
+	for (uint32_t i = 0; i < num_entries; i++) {
+		write_u64(out, entries[i].hash);
+		write_u16(out, entries[i].name_idx);
+		write_u16(out, entries[i].costume);
+	}
+
+	fclose(out);
+	printf("wrote %u hashes for %u names to %s\n", num_entries, num_names, argv[2]);
+	ret = 0;
+
+done:
+	fclose(list);
+	for (uint32_t i = 0; i < num_names; i++) {
+		free(names[i]);
+	}
+	free(entries);
+	return ret;
+}
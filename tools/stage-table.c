@@ -0,0 +1,158 @@
+/*
+ * Builds the stage signature table loaded by the plugin (ssbu-stages.bin).
+ *
+ * usage: autovod-stage-table <list.tsv> <out.bin>
+ *
+ * Each line of the list is "<name>\t<gameplay png>". Several captures of the
+ * same stage are averaged into one histogram, which evens out the camera
+ * zoom and the fighters covering parts of the background.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "img-utils.h"
+#include "game-detect/smash-ultimate-stage.h"
+
+#define MAX_STAGES 256
+#define MAX_LINE 1024
+
+struct stage_entry {
+	char *name;
+	uint32_t sums[SSBU_STAGE_HIST_BINS];
+	uint32_t count;
+};
+
+static bool read_png(const char *filename, struct frame_data *frame)
+{
+	png_image image;
+
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&image, filename)) {
+		return false;
+	}
+
+	image.format = PNG_FORMAT_RGBA;
+	frame_data_init(frame, image.width, image.height);
+
+	if (!png_image_finish_read(&image, NULL, frame->rgba_data, 0, NULL)) {
+		frame_data_destroy(frame);
+		return false;
+	}
+
+	return true;
+}
+
+static void write_u32(FILE *fp, uint32_t val)
+{
+	uint8_t buf[4] = {(uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16),
+			  (uint8_t)(val >> 24)};
+	fwrite(buf, 1, sizeof(buf), fp);
+}
+
+static struct stage_entry *find_or_add_stage(struct stage_entry *stages, uint32_t *num_stages,
+					     const char *name)
+{
+	for (uint32_t i = 0; i < *num_stages; i++) {
+		if (strcmp(stages[i].name, name) == 0)
+			return &stages[i];
+	}
+
+	if (*num_stages >= MAX_STAGES || strlen(name) > 255)
+		return NULL;
+
+	struct stage_entry *stage = &stages[(*num_stages)++];
+	memset(stage, 0, sizeof(*stage));
+	stage->name = strdup(name);
+	return stage;
+}
+
+int main(int argc, char **argv)
+{
+	static struct stage_entry stages[MAX_STAGES];
+	uint32_t num_stages = 0;
+	char line[MAX_LINE];
+	int ret = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <list.tsv> <out.bin>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *list = fopen(argv[1], "r");
+	if (!list) {
+		fprintf(stderr, "failed to open %s\n", argv[1]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), list)) {
+		struct frame_data frame;
+		uint8_t hist[SSBU_STAGE_HIST_BINS];
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *name = strtok(line, "\t");
+		char *path = strtok(NULL, "\t");
+
+		if (!name || !path || name[0] == '#') {
+			continue;
+		}
+
+		struct stage_entry *stage = find_or_add_stage(stages, &num_stages, name);
+		if (!stage) {
+			fprintf(stderr, "too many or too long names at '%s'\n", name);
+			goto done;
+		}
+
+		if (!read_png(path, &frame)) {
+			fprintf(stderr, "failed to read %s\n", path);
+			goto done;
+		}
+
+		ssbu_stage_histogram(&frame, hist);
+		for (uint32_t i = 0; i < SSBU_STAGE_HIST_BINS; i++) {
+			stage->sums[i] += hist[i];
+		}
+		stage->count++;
+
+		frame_data_destroy(&frame);
+	}
+
+	FILE *out = fopen(argv[2], "wb");
+	if (!out) {
+		fprintf(stderr, "failed to open %s\n", argv[2]);
+		goto done;
+	}
+
+	fwrite(SSBU_STAGE_TABLE_MAGIC, 1, 4, out);
+	write_u32(out, SSBU_STAGE_TABLE_VERSION);
+	write_u32(out, num_stages);
+
+	for (uint32_t i = 0; i < num_stages; i++) {
+		uint8_t len = (uint8_t)strlen(stages[i].name);
+		uint8_t hist[SSBU_STAGE_HIST_BINS];
+
+		for (uint32_t j = 0; j < SSBU_STAGE_HIST_BINS; j++) {
+			hist[j] = (uint8_t)((stages[i].sums[j] + stages[i].count / 2) /
+					    stages[i].count);
+		}
+
+		fwrite(&len, 1, 1, out);
+		fwrite(stages[i].name, 1, len, out);
+		fwrite(hist, 1, sizeof(hist), out);
+		printf("%s (%u captures)\n", stages[i].name, stages[i].count);
+	}
+
+	fclose(out);
+	printf("wrote %u stages to %s\n", num_stages, argv[2]);
+	ret = 0;
+
+done:
+	fclose(list);
+	for (uint32_t i = 0; i < num_stages; i++) {
+		free(stages[i].name);
+	}
+	return ret;
+}
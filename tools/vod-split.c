@@ -0,0 +1,373 @@
+/*
+ * Cuts a recording into one file per game using a segment manifest written
+ * by the plugin. Packets are stream copied, so cuts land on the nearest
+ * video keyframes: each clip starts at the last keyframe at or before the
+ * game start and ends at the first keyframe at or after the game end.
+ *
+ * Each clip is widened by the manifest's base_uncertainty on both sides,
+ * -t adds a measured offset between the manifest base and the recording's
+ * first frame to every time.
+ *
+ * usage: autovod-split [-j jobs] [-o outdir] [-r recording] [-t offset] <manifest.json>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <obs.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+
+#define MAX_JOBS 64
+
+struct split_job {
+	const char *recording;
+	char *out_file;
+	double start;
+	double end;
+	bool success;
+	uint64_t bytes;
+};
+
+struct split_queue {
+	pthread_mutex_t mutex;
+	struct split_job *jobs;
+	size_t num_jobs;
+	size_t next_job;
+};
+
+static bool split_segment(struct split_job *job)
+{
+	AVFormatContext *in = NULL;
+	AVFormatContext *out = NULL;
+	AVPacket *pkt = NULL;
+	int *stream_map = NULL;
+	bool success = false;
+	int video_idx;
+	int64_t start_pts = AV_NOPTS_VALUE;
+	int64_t start_dts = AV_NOPTS_VALUE;
+
+	if (avformat_open_input(&in, job->recording, NULL, NULL) < 0 ||
+	    avformat_find_stream_info(in, NULL) < 0) {
+		fprintf(stderr, "failed to open %s\n", job->recording);
+		goto done;
+	}
+
+	video_idx = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (video_idx < 0) {
+		fprintf(stderr, "no video stream in %s\n", job->recording);
+		goto done;
+	}
+
+	if (avformat_alloc_output_context2(&out, NULL, NULL, job->out_file) < 0) {
+		goto done;
+	}
+
+	stream_map = calloc(in->nb_streams, sizeof(int));
+	for (unsigned i = 0, n = 0; i < in->nb_streams; i++) {
+		AVCodecParameters *par = in->streams[i]->codecpar;
+
+		if (par->codec_type != AVMEDIA_TYPE_VIDEO && par->codec_type != AVMEDIA_TYPE_AUDIO) {
+			stream_map[i] = -1;
+			continue;
+		}
+
+		AVStream *stream = avformat_new_stream(out, NULL);
+		if (!stream || avcodec_parameters_copy(stream->codecpar, par) < 0) {
+			goto done;
+		}
+		stream->codecpar->codec_tag = 0;
+		stream->time_base = in->streams[i]->time_base;
+		stream_map[i] = (int)n++;
+	}
+
+	if (!(out->oformat->flags & AVFMT_NOFILE) &&
+	    avio_open(&out->pb, job->out_file, AVIO_FLAG_WRITE) < 0) {
+		fprintf(stderr, "failed to create %s\n", job->out_file);
+		goto done;
+	}
+
+	if (avformat_write_header(out, NULL) < 0) {
+		goto done;
+	}
+
+	// seeking backwards on the video stream lands on the keyframe before start
+	AVStream *video = in->streams[video_idx];
+	int64_t seek_ts = av_rescale_q((int64_t)(job->start * AV_TIME_BASE), AV_TIME_BASE_Q,
+				       video->time_base);
+	if (video->start_time != AV_NOPTS_VALUE) {
+		seek_ts += video->start_time;
+	}
+	av_seek_frame(in, video_idx, seek_ts, AVSEEK_FLAG_BACKWARD);
+
+	pkt = av_packet_alloc();
+	while (av_read_frame(in, pkt) >= 0) {
+		AVStream *in_stream = in->streams[pkt->stream_index];
+		int out_idx = stream_map[pkt->stream_index];
+
+		if (out_idx < 0 || pkt->pts == AV_NOPTS_VALUE) {
+			av_packet_unref(pkt);
+			continue;
+		}
+
+		double t = (double)(pkt->pts - (in_stream->start_time != AV_NOPTS_VALUE
+							? in_stream->start_time
+							: 0)) *
+			   av_q2d(in_stream->time_base);
+		bool keyframe = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+
+		if (pkt->stream_index == video_idx) {
+			if (start_pts == AV_NOPTS_VALUE) {
+				if (!keyframe) {
+					av_packet_unref(pkt);
+					continue;
+				}
+				start_pts = av_rescale_q(pkt->pts, in_stream->time_base,
+							 AV_TIME_BASE_Q);
+				// shifting by the decode time keeps the keyframe's dts at 0
+				start_dts = pkt->dts != AV_NOPTS_VALUE
+						    ? av_rescale_q(pkt->dts, in_stream->time_base,
+								   AV_TIME_BASE_Q)
+						    : start_pts;
+			}
+
+			if (keyframe && t >= job->end) {
+				av_packet_unref(pkt);
+				break;
+			}
+		} else if (start_pts == AV_NOPTS_VALUE ||
+			   av_rescale_q(pkt->pts, in_stream->time_base, AV_TIME_BASE_Q) <
+				   start_pts) {
+			// audio before the first video keyframe would start the clip early
+			av_packet_unref(pkt);
+			continue;
+		}
+
+		AVStream *out_stream = out->streams[out_idx];
+		int64_t offset = av_rescale_q(start_dts, AV_TIME_BASE_Q, in_stream->time_base);
+
+		// rounding between time bases can still land a packet just below 0
+		pkt->pts = FFMAX(pkt->pts - offset, 0);
+		if (pkt->dts != AV_NOPTS_VALUE) {
+			pkt->dts = FFMIN(FFMAX(pkt->dts - offset, 0), pkt->pts);
+		}
+		av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+		pkt->stream_index = out_idx;
+		pkt->pos = -1;
+		job->bytes += (uint64_t)pkt->size;
+
+		if (av_interleaved_write_frame(out, pkt) < 0) {
+			fprintf(stderr, "write failed for %s\n", job->out_file);
+			goto done;
+		}
+	}
+
+	success = av_write_trailer(out) == 0;
+
+done:
+	av_packet_free(&pkt);
+	if (out) {
+		if (!(out->oformat->flags & AVFMT_NOFILE))
+			avio_closep(&out->pb);
+		avformat_free_context(out);
+	}
+	avformat_close_input(&in);
+	free(stream_map);
+	return success;
+}
+
+static void *split_worker(void *data)
+{
+	struct split_queue *queue = data;
+
+	while (1) {
+		pthread_mutex_lock(&queue->mutex);
+		size_t idx = queue->next_job++;
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (idx >= queue->num_jobs) {
+			break;
+		}
+
+		struct split_job *job = &queue->jobs[idx];
+		job->success = split_segment(job);
+		printf("%s %s (%.1fs - %.1fs)\n", job->success ? "wrote" : "FAILED", job->out_file,
+		       job->start, job->end);
+	}
+
+	return NULL;
+}
+
+static void append_name(struct dstr *str, const char *name)
+{
+	for (const char *c = name; *c; c++) {
+		char ch = isalnum((unsigned char)*c) ? (char)tolower((unsigned char)*c) : '_';
+		dstr_ncat(str, &ch, 1);
+	}
+}
+
+static char *clip_path(const char *out_dir, const char *recording, size_t idx, const char *player1,
+		       const char *player2, const char *stage)
+{
+	struct dstr path = {0};
+	const char *base = strrchr(recording, '/');
+	const char *ext = strrchr(recording, '.');
+
+#ifdef _WIN32
+	const char *base_win = strrchr(recording, '\\');
+	if (base_win > base)
+		base = base_win;
+#endif
+	base = base ? base + 1 : recording;
+	if (!ext || ext < base)
+		ext = ".mkv";
+
+	if (out_dir) {
+		dstr_printf(&path, "%s/", out_dir);
+	} else {
+		dstr_ncopy(&path, recording, base - recording);
+	}
+
+	dstr_ncat(&path, base, ext - base);
+	dstr_catf(&path, "-game%02zu", idx + 1);
+
+	if (*player1 || *player2) {
+		dstr_cat(&path, "-");
+		append_name(&path, *player1 ? player1 : "unknown");
+		dstr_cat(&path, "-vs-");
+		append_name(&path, *player2 ? player2 : "unknown");
+	}
+
+	if (*stage) {
+		dstr_cat(&path, "-on-");
+		append_name(&path, stage);
+	}
+
+	dstr_cat(&path, ext);
+	return path.array;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out_dir = NULL;
+	const char *recording = NULL;
+	const char *manifest_path = NULL;
+	double time_offset = 0.0;
+	int num_threads = 4;
+	struct split_queue queue = {0};
+	pthread_t threads[MAX_JOBS];
+	int ret = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			num_threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out_dir = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			recording = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			time_offset = atof(argv[++i]);
+		} else {
+			manifest_path = argv[i];
+		}
+	}
+
+	if (!manifest_path) {
+		fprintf(stderr,
+			"usage: %s [-j jobs] [-o outdir] [-r recording] [-t offset] "
+			"<manifest.json>\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (num_threads < 1)
+		num_threads = 1;
+	if (num_threads > MAX_JOBS)
+		num_threads = MAX_JOBS;
+
+	obs_data_t *manifest = obs_data_create_from_json_file(manifest_path);
+	if (!manifest) {
+		fprintf(stderr, "failed to read %s\n", manifest_path);
+		return 1;
+	}
+
+	if (!recording) {
+		recording = obs_data_get_string(manifest, "recording");
+	}
+
+	if (!recording || !*recording) {
+		fprintf(stderr, "manifest has no recording, pass one with -r\n");
+		goto done;
+	}
+
+	double uncertainty = obs_data_get_double(manifest, "base_uncertainty");
+	obs_data_array_t *segments = obs_data_get_array(manifest, "segments");
+	queue.num_jobs = obs_data_array_count(segments);
+	queue.jobs = calloc(queue.num_jobs ? queue.num_jobs : 1, sizeof(struct split_job));
+
+	for (size_t i = 0; i < queue.num_jobs; i++) {
+		obs_data_t *segment = obs_data_array_item(segments, i);
+		struct split_job *job = &queue.jobs[i];
+
+		job->recording = recording;
+		job->start = obs_data_get_double(segment, "start") + time_offset - uncertainty;
+		job->end = obs_data_get_double(segment, "end") + time_offset + uncertainty;
+		if (job->start < 0.0)
+			job->start = 0.0;
+		job->out_file = clip_path(out_dir, recording, i,
+					  obs_data_get_string(segment, "player1"),
+					  obs_data_get_string(segment, "player2"),
+					  obs_data_get_string(segment, "stage"));
+		obs_data_release(segment);
+	}
+	obs_data_array_release(segments);
+
+	uint64_t start_ns = os_gettime_ns();
+	pthread_mutex_init(&queue.mutex, NULL);
+
+	// each segment opens the recording separately, so they are independent
+	// and the split is bound by disk throughput
+	int started = 0;
+	for (; started < num_threads; started++) {
+		if (pthread_create(&threads[started], NULL, split_worker, &queue) != 0) {
+			fprintf(stderr, "failed to start worker thread %d of %d\n", started + 1,
+				num_threads);
+			break;
+		}
+	}
+
+	// the queue is shared, the workers that did start take every segment,
+	// and without any the main thread does the split itself
+	if (!started) {
+		split_worker(&queue);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&queue.mutex);
+
+	uint64_t total_bytes = 0;
+	size_t failed = 0;
+	for (size_t i = 0; i < queue.num_jobs; i++) {
+		total_bytes += queue.jobs[i].bytes;
+		failed += queue.jobs[i].success ? 0 : 1;
+		bfree(queue.jobs[i].out_file);
+	}
+
+	double seconds = (double)(os_gettime_ns() - start_ns) / 1e9;
+	printf("%zu clips, %zu failed, %.1f MB in %.1fs (%.1f MB/s)\n", queue.num_jobs, failed,
+	       (double)total_bytes / 1e6, seconds,
+	       seconds > 0.0 ? (double)total_bytes / 1e6 / seconds : 0.0);
+
+	free(queue.jobs);
+	ret = failed ? 1 : 0;
+
+done:
+	obs_data_release(manifest);
+	return ret;
+}